@@ -15,10 +15,10 @@ using namespace boost;
 template <typename Dtype>
 class Blob{
 public:
-	Blob():data_(),diff_(),count_(0), capacity_(0) {}
-	Blob(const vector<int>& shape) :count_(0),capacity_(0) { reshape(shape); }
+	Blob():data_(),diff_(),count_(0), capacity_(0), data_exposed(false) {}
+	Blob(const vector<int>& shape) :count_(0),capacity_(0), data_exposed(false) { reshape(shape); }
 	void reshape(int num, int channels, int height, int width);
-	void reshape(vector<int> shape);
+	void reshape(const vector<int>& shape);
 	void reshape(const BlobShape& blob_shape);
 	void reshapeLike(const Blob& blob);
 	const Dtype* cpu_data() const;
@@ -91,7 +91,12 @@ public:
 		else return axis;
 	}
 	const boost::shared_ptr<SyncedMemory>& data() const { return data_; }
-	const boost::shared_ptr<SyncedMemory>& diff() const { return diff_; }
+	//	diff is allocated at the first access
+	//	blobs never used in backward(e.g. all blobs of a TEST net) have no diffs
+	const boost::shared_ptr<SyncedMemory>& diff() const { allocDiff(); return diff_; }
+	bool has_diff() const { return (bool)diff_; }
+	//	drop the diff, it will be allocated again if anyone uses it
+	void releaseDiff() { diff_.reset(); }
 	//	change the shared_ptr object and will recycle the memory if need
 	void shareData(const Blob& blob) {
 		CHECK_EQ(count(), blob.count());
@@ -101,12 +106,43 @@ public:
 		CHECK_EQ(count(), blob.count());
 		diff_ = blob.diff();
 	}
+	//	use an external memory(e.g. a slot planned by Net) as data
+	void shareData(const boost::shared_ptr<SyncedMemory>& memory) {
+		CHECK_GE(memory->size(), count_*sizeof(Dtype));
+		data_ = memory;
+		//	growing over the shared memory must allocate a new one
+		capacity_ = min(capacity_, (int)(memory->size() / sizeof(Dtype)));
+	}
+	void shareDiff(const boost::shared_ptr<SyncedMemory>& memory) {
+		CHECK_GE(memory->size(), count_*sizeof(Dtype));
+		diff_ = memory;
+		capacity_ = min(capacity_, (int)(memory->size() / sizeof(Dtype)));
+	}
+	//	exchange the data with a blob of the same count(e.g. a prefetched batch) without copying
+	//	whoever kept the old data() must compare data()/version() again before trusting it
+	//	do not swap a blob whose data is exposed, its holders can not check anything
+	void swapData(Blob& blob) {
+		CHECK(!data_exposed && !blob.data_exposed) << "the data of the blob is held outside.";
+		CHECK_EQ(count(), blob.count());
+		data_.swap(blob.data_);
+		capacity_ = min(capacity_, (int)(data_->size() / sizeof(Dtype)));
+		blob.capacity_ = min(blob.capacity_, (int)(blob.data_->size() / sizeof(Dtype)));
+	}
+	//	the data pointer is handed outside(e.g. a numpy view of the python wrapper)
+	//	and may be kept for ever, the data layer copies into such a top instead of swapping
+	void exposeData() { data_exposed = true; }
+	bool dataExposed() const { return data_exposed; }
 	void FromProto(const BlobProto& proto, bool need_reshape = true);
 	void ToProto(BlobProto* proto, bool write_diff = false);
 protected:
-	boost::shared_ptr<SyncedMemory> data_, diff_;
+	void allocDiff() const {
+		if (!diff_) diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+	}
+	boost::shared_ptr<SyncedMemory> data_;
+	mutable boost::shared_ptr<SyncedMemory> diff_;
 	vector<int> shape_;
 	int count_, capacity_;
+	bool data_exposed;
 };
 
 template<typename Dtype>
@@ -32,6 +32,8 @@ using namespace boost;
 #include <cuda.h>
 #endif
 
+class ThreadPool;
+
 class Dragon{
 public:
 	Dragon();
@@ -58,6 +60,17 @@ public:
 		return (*rng)();
 	}
 	static int64_t cluster_seedgen();
+	//	intra-op threads for the CPU kernels, the calling thread included
+	//	1 disables the pool, each thread's Dragon has its own setting
+	//	OpenBLAS is told the same count so both pools share the cores
+	//	set_blas=false leaves OpenBLAS alone, its count is global to the process
+	static int get_num_threads() { return Get().num_threads; }
+	static void set_num_threads(int num_threads, bool set_blas = true);
+	//	pin the pool's workers to the cores
+	static bool get_thread_affinity() { return Get().thread_affinity; }
+	static void set_thread_affinity(bool val);
+	//	created at the first use, NULL if the pool is disabled
+	static ThreadPool* get_thread_pool();
 	class RNG{
 	public:
 		RNG() { generator.reset(new Generator()); }
@@ -86,6 +99,9 @@ private:
 	int solver_count;
 	bool root_solver;
 	boost::shared_ptr<RNG> random_generator;
+	int num_threads;
+	bool thread_affinity;
+	boost::shared_ptr<ThreadPool> thread_pool;
 #ifndef CPU_ONLY
 	cublasHandle_t cublas_handle;
 	curandGenerator_t curand_generator;
@@ -3,19 +3,42 @@
 
 #include "dragon_thread.hpp"
 #include "protos/dragon.pb.h"
-#include "utils/blocking_queue.hpp"
+#include "utils/ring_queue.hpp"
 #include "utils/db.hpp"
+#include "utils/datum_view.hpp"
 
 // QueuePair is the basic applicated DataStructure
 // it is equal to a producter/consumer model
 // free&full can be regard as a memory queue with Semaphore
+// each side has one thread(the reader/the layer), so they are SPSC rings
+// the Datums are views into the DB, which stay valid while its reader lives
 
 class QueuePair{
 public:
 	QueuePair(const int size);
 	~QueuePair();
-	BlockingQueue<Datum*> free; // as producter queue
-	BlockingQueue<Datum*> full; // as consumer queue
+	SPSCRing<DatumView*> free; // as producter queue
+	SPSCRing<DatumView*> full; // as consumer queue
+};
+
+// ShardReader reads count records from begin_key circularly
+// with its own read transaction/cursor into its own Datum list
+// Body merges the shards into the QueuePairs of solvers
+
+class ShardReader :public DragonThread{
+public:
+	ShardReader(Cursor *cursor, const string& begin_key, const size_t count,
+		const int capacity, const int id, MPMCRing<int> *ready);
+	virtual ~ShardReader();
+	QueuePair pair;
+protected:
+	void interfaceKernel();
+	boost::shared_ptr<Cursor> cursor;
+	string begin_key;
+	size_t count;
+	int id;
+	//	ids of shards which read a Datum, NULL in the strict order
+	MPMCRing<int> *ready;
 };
 
 // Body is a basic data-reading thread
@@ -32,6 +55,8 @@ public:
 protected:
 	void interfaceKernel(); 
 	void read_one(Cursor *cursor, QueuePair *pair);
+	//	data_param().readers() > 1
+	void read_sharded(DB *db);
 	LayerParameter param;
 };
 
@@ -39,8 +64,8 @@ class DataReader
 {
 public:
 	DataReader(const LayerParameter& param);
-	BlockingQueue<Datum*>& free() const  { return ptr_pair->free; }
-	BlockingQueue<Datum*>& full() const  { return ptr_pair->full; }
+	SPSCRing<DatumView*>& free() const  { return ptr_pair->free; }
+	SPSCRing<DatumView*>& full() const  { return ptr_pair->full; }
 	~DataReader();
 	static string source_key(const LayerParameter& param){
 		return param.name() + ":" + param.data_param().source();
@@ -5,6 +5,7 @@
 #include "protos/dragon.pb.h"
 #include "blob.hpp"
 #include "common.hpp"
+#include "utils/datum_view.hpp"
 
 #ifndef DISABLE_OPENCV
 #include <opencv2/opencv.hpp>
@@ -20,18 +21,35 @@ class DataTransformer
 public:
 	DataTransformer(const TransformationParameter& param, Phase phase);
 	vector<int> inferBlobShape(const Datum& datum);
+	vector<int> inferBlobShape(const DatumView& datum);
 	vector<int> inferBlobShape(const Mat& mat);
 	void transform(const Datum& datum, Blob<Dtype>* shadow_blob);
 	void transform(const Datum& datum, Dtype* shadow_data);
+	//	draw the random crop/mirror from rng instead of the own stream
+	//	it does not touch the transformer, so workers can call it concurrently
+	void transform(const Datum& datum, Dtype* shadow_data, rng_t* rng);
+	//	the pixels go from the buffer of the view into shadow_data directly
+	void transform(const DatumView& datum, Dtype* shadow_data);
+	void transform(const DatumView& datum, Dtype* shadow_data, rng_t* rng);
 	void transform(const Mat& cv_img, Dtype* shadow_data);
 	void initRand();
+	//	an independent stream for the stream_th worker, derived from the seed of the transformer
+	//	NULL if the transform is deterministic
+	boost::shared_ptr<Dragon::RNG> forkRand(const int stream) const;
 	~DataTransformer() {}
 	int rand(int n);
 private:
+	static int rand(int n, rng_t* rng);
+	//	Datum and DatumView share the accessors
+	template <typename DatumType>
+	vector<int> inferDatumShape(const DatumType& datum);
+	template <typename DatumType>
+	void transformDatum(const DatumType& datum, Dtype* shadow_data, rng_t* rng);
 	TransformationParameter param;
 	Phase phase;
 	Blob<Dtype> mean_blob;
 	vector<Dtype> mean_vals;
 	boost::shared_ptr<Dragon::RNG> ptr_rng;
+	unsigned int rng_seed;
 };
 #endif
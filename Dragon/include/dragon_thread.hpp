@@ -8,7 +8,8 @@ class DragonThread
 public:
 	DragonThread() {}
 	virtual ~DragonThread();
-	void initializeThread(int device, Dragon::Mode mode, int rand_seed, int solver_count, bool root_solver);
+	void initializeThread(int device, Dragon::Mode mode, int rand_seed, int solver_count, bool root_solver,
+		int num_threads, bool thread_affinity);
 	void startThread();
 	void stopThread();
 	//the interface implements for specific working task 
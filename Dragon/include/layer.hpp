@@ -38,6 +38,12 @@ public:
 		this->is_shared = is_shared;
 	}
 	virtual bool shareInParallel() { return false; }
+	//	whether tops use the data of bottom[0] directly in forward
+	//	the memory planner of Net treats those tops as bottom[0] itself
+	virtual bool forwardSharesData() const { return false; }
+	//	Net skips reshape() while the shapes of bottoms are unchanged
+	//	layers whose reshape() does more than shaping(e.g. shares memory) must run it every forward
+	virtual bool reshapeEveryForward() const { return false; }
 	void setParamNeedBp(const int param_id, const bool is_need){
 		if (param_need_bp.size() <= param_id) param_need_bp.resize(param_id + 1, true);
 		param_need_bp[param_id] = is_need;
@@ -67,16 +73,16 @@ public:
 		if (num){
 			CHECK_EQ(top.size(), num)
 				<< "The number of loss_weights must equal to the number of top blobs.";
+			loss_multipliers.resize(top.size());
 			for (int top_id = 0; top_id < top.size(); top_id++){
 				const Dtype loss_weight = param.loss_weight(top_id);
 				if (loss_weight == Dtype(0)) continue;
 				setLoss(top_id, loss_weight);
-				const int cnt = top[top_id]->count();
-				//	store the diff's value as loss_weight (0-invaild/1-vaild)
-				//	this only work in LossLayer
-				//	because LossLayer need not diff to backward propogation
-				Dtype *loss_multiplier = top[top_id]->mutable_cpu_diff();
-				dragon_set(cnt, loss_weight, loss_multiplier);
+				//	keep the loss weight in a private scalar instead of the top diff
+				//	so forward never touches diffs (e.g. in TEST nets)
+				//	the dot broadcasts it with a zero stride
+				loss_multipliers[top_id].reset(new Blob<Dtype>(vector<int>(1, 1)));
+				loss_multipliers[top_id]->mutable_cpu_data()[0] = loss_weight;
 			}
 		}
 
@@ -89,10 +95,10 @@ public:
 		setLossWeight(top);
 		setResultWeight(top);
 	}
-	Dtype forward(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
+	Dtype forward(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top, const bool need_reshape = true){
 		lock();
 		Dtype tot_loss = 0;
-		reshape(bottom, top);
+		if (need_reshape || reshapeEveryForward()) reshape(bottom, top);
 		switch (Dragon::get_mode()){
 			case Dragon::CPU:
 				forward_cpu(bottom, top);
@@ -101,10 +107,10 @@ public:
 					if (!getLoss(top_id)) continue;
 					const int cnt = top[top_id]->count();
 					//	data represent loss
-					//	loss_weights(0/1) represent whether use loss
+					//	loss_weight(0/1) represent whether use loss
 					const Dtype* data = top[top_id]->cpu_data();
-					const Dtype* loss_weights = top[top_id]->cpu_diff();
-					tot_loss += dragon_cpu_dot<Dtype>(cnt, data, loss_weights);
+					const Dtype* loss_weight = loss_multipliers[top_id]->cpu_data();
+					tot_loss += dragon_cpu_strided_dot<Dtype>(cnt, data, 1, loss_weight, 0);
 				}
 				break;
 			case Dragon::GPU:
@@ -114,8 +120,8 @@ public:
 					if (!getLoss(top_id)) continue;
 					const int cnt = top[top_id]->count();
 					const Dtype* data = top[top_id]->gpu_data();
-					const Dtype* loss_weights = top[top_id]->gpu_diff();
-					tot_loss+=dragon_gpu_dot(cnt, data, loss_weights);
+					const Dtype* loss_weight = loss_multipliers[top_id]->gpu_data();
+					tot_loss += dragon_gpu_strided_dot<Dtype>(cnt, data, 1, loss_weight, 0);
 				}
 #endif
 				break;
@@ -128,9 +134,20 @@ public:
 	void backward(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom){
 		switch (Dragon::get_mode()){
 			case Dragon::CPU:
+				//	the gradient of a loss top is its loss weight
+				for (int top_id = 0; top_id < top.size(); top_id++){
+					if (!getLoss(top_id)) continue;
+					dragon_set(top[top_id]->count(), getLoss(top_id), top[top_id]->mutable_cpu_diff());
+				}
 				backward_cpu(top, data_need_bp, bottom);
 				break;
 			case Dragon::GPU:
+#ifndef CPU_ONLY
+				for (int top_id = 0; top_id < top.size(); top_id++){
+					if (!getLoss(top_id)) continue;
+					dragon_gpu_set(top[top_id]->count(), getLoss(top_id), top[top_id]->mutable_gpu_diff());
+				}
+#endif
 				backward_gpu(top, data_need_bp, bottom);
 				break;
 			default:
@@ -151,6 +168,7 @@ protected:
 	vector < bool > param_need_bp;
 	boost::shared_ptr<boost::mutex> forward_mutex;
 	vector<Dtype> loss;
+	vector<boost::shared_ptr<Blob<Dtype> > > loss_multipliers;
 	virtual void forward_cpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) = 0;
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom) = 0;
 	virtual void forward_gpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
@@ -8,6 +8,8 @@ class ConcatLayer :public Layer < Dtype > {
 public:
 	ConcatLayer(const LayerParameter& param) :Layer<Dtype>(param) {}
 	virtual void reshape(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
+	//	a single bottom is shared with top in reshape()
+	virtual bool reshapeEveryForward() const { return param.bottom_size() == 1; }
 protected:
 	virtual void forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
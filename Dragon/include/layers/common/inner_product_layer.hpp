@@ -2,6 +2,7 @@
 # define INNER_PRODUCT_LAYER_HPP
 
 #include "../../layer.hpp"
+#include "../../utils/epilogue.hpp"
 
 template <typename Dtype>
 class InnerProductLayer :public Layer < Dtype > {
@@ -17,6 +18,10 @@ protected:
 	int M, N, K;
 	bool bias_term;
 	Blob<Dtype> bias_multiplier;
+	//	a ReLU fused by Net, see also BaseConvolutionLayer
+	bool fused_relu;
+	Dtype relu_slope;
+	boost::shared_ptr<SyncedMemory> relu_mask;
 };
 
 #endif
\ No newline at end of file
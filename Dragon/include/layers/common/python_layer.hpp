@@ -21,6 +21,8 @@ public:
 		self.attr("reshape")(bottom, top);
 	}
 	virtual bool shareInParallel() { return param.python_param().share_in_parallel(); }
+	//	the python reshape() can do anything
+	virtual bool reshapeEveryForward() const { return true; }
 protected:
 	virtual void forward_cpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
 		self.attr("forward")(bottom, top);
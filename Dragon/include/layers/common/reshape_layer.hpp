@@ -10,6 +10,8 @@ public:
 	ReshapeLayer(const LayerParameter& param) :Layer<Dtype>(param) {}
 	virtual void layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 	virtual void reshape(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
+	//	top shares the memory of bottom in reshape()
+	virtual bool reshapeEveryForward() const { return true; }
 protected:
 	virtual void forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top) {}
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom) {}
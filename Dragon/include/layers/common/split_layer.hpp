@@ -8,6 +8,7 @@ class SplitLayer :public Layer < Dtype > {
 public:
 	SplitLayer(const LayerParameter& param) :Layer<Dtype>(param) {}
 	virtual void reshape(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
+	virtual bool forwardSharesData() const { return true; }
 protected:
 	virtual void forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
@@ -2,6 +2,7 @@
 # define PREFETCHING_DATA_LAYERS_HPP
 
 #include "../../dragon_thread.hpp"
+#include "../../utils/thread_pool.hpp"
 #include "base_data_layer.hpp"
 
 template<typename Dtype>
@@ -22,8 +23,14 @@ protected:
 	virtual void interfaceKernel();
 	virtual void loadBatch(Batch<Dtype>* batch);
 	Batch<Dtype>* prefetch;
-	BlockingQueue<Batch<Dtype>*> free;
-	BlockingQueue<Batch<Dtype>*> full;
+	//	the layer recycles batches and the prefetching thread fills them
+	SPSCRing<Batch<Dtype>*> free;
+	SPSCRing<Batch<Dtype>*> full;
+	//	parallel batch assembly, the prefetching thread is one of the workers
+	int transform_workers;
+	boost::shared_ptr<ThreadPool> transform_pool;
+	vector<boost::shared_ptr<Dragon::RNG> > worker_rngs;
+	vector<DatumView*> batch_datums;
 };
 
 # endif
\ No newline at end of file
@@ -14,9 +14,14 @@ protected:
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
 	virtual void forward_gpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 	virtual void backward_gpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
+	//	the GPU path runs a SoftmaxLayer
 	boost::shared_ptr<Layer<Dtype>> softmax_layer;
 	vector<Blob<Dtype>*> softmax_bottom, softmax_top;
 	Blob<Dtype> prob;
+	//	CPU: log(sum(exp(x))) of each (outer, inner) position from forward
+	//	backward computes the softmax from it and the logits directly
+	Blob<Dtype> log_sum;
+	int valid_count;
 	bool need_norm;
 	int axis, outer_num, inner_num, ignore_label;
 	bool has_ignore_label, has_normalize;
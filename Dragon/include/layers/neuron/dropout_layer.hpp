@@ -14,9 +14,13 @@ protected:
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
 	virtual void forward_gpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
 	virtual void backward_gpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
-	Dtype prob;
+	//	inverted dropout: the kept units are scaled by 1/(1-prob) in TRAIN, TEST is a no-op
+	Dtype prob, scale;
 	unsigned int threshold;
+	//	GPU: a uniform number per unit, compared with threshold
 	Blob<unsigned int> rand_vec;
+	//	CPU: the kept units as bits, 32 units per word
+	Blob<unsigned int> mask_bits;
 };
 
 # endif
\ No newline at end of file
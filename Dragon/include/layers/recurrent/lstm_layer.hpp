@@ -9,6 +9,8 @@ public:
 	LSTMLayer(const LayerParameter& param) :Layer<Dtype>(param) {}
 	virtual void layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 	virtual void reshape(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
+	//	output shares the memory of top[0] in reshape()
+	virtual bool reshapeEveryForward() const { return true; }
 protected:
 	virtual void forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
@@ -3,6 +3,9 @@
 
 # include "../../layer.hpp"
 # include "../../utils/im2col.hpp"
+# include "../../utils/workspace.hpp"
+# include "../../utils/depthwise.hpp"
+# include "../../utils/epilogue.hpp"
 
 template <typename Dtype>
 class BaseConvolutionLayer :public Layer<Dtype>{
@@ -15,10 +18,11 @@ protected:
 	Blob<int> stride;
 	Blob<int> pad;
 	Blob<int> conv_input_shape;
+	//	im2col buffer is borrowed from the thread's workspace
 	vector<int> col_buffer_shape;
+	int col_buffer_count;
 	vector<int> output_shape;
 	vector<int> bottom_shape;
-	Blob<Dtype> col_buffer;
 	Blob<Dtype> bias_multiplier;
 	int num_axes, num_spatial_axes;
 	int bottom_dim, top_dim;
@@ -26,6 +30,19 @@ protected:
 	int num, channels, group, out_spatial_dim;
 	int weight_offset, num_output;
 	bool bias_term, is_1x1, force_nd_im2col;
+	//	group == channels, use the direct kernels on cpu instead of group tiny gemms
+	bool is_depthwise;
+	//	images patched together by the batched cpu gemms, 1 means disabled
+	int im2col_batch, im2col_batch_memory;
+	//	a ReLU fused by Net, applied with the bias in the cpu epilogue
+	//	relu_mask keeps the sign of the pre-activations for backward in TRAIN
+	bool fused_relu;
+	Dtype relu_slope;
+	boost::shared_ptr<SyncedMemory> relu_mask;
+	unsigned char* reluMask(const int top_id, const int n){
+		if (!relu_mask) return NULL;
+		return (unsigned char*)relu_mask->mutable_cpu_data() + ((size_t)top_id*num + n)*top_dim;
+	}
 
 	int num_kernels_im2col, num_kernels_col2im;
 	int conv_in_channels, conv_out_channels;
@@ -33,11 +50,26 @@ protected:
 	int col_offset, output_offset;
 	virtual bool reverseDimensions() = 0;
 	virtual void computeOutputShape() = 0;
-	void forward_cpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output, bool skip_im2col = false);
-	void forward_cpu_bias(Dtype* output, const Dtype* bias);
+	//	col: patch the input into it instead of the workspace(forward)
+	//	or use it as the patched input directly(weight gradient)
+	void forward_cpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output, bool skip_im2col = false,
+		Dtype* col = NULL);
+	//	bias(can be NULL) and the fused ReLU for an image
+	void forward_cpu_epilogue(Dtype* output, const Dtype* bias, unsigned char* mask);
+	//	top diff of the pre-activations, written in place as an in-place ReLU does
+	const Dtype* backward_cpu_epilogue(const int top_id, Blob<Dtype>* top);
 	void backward_cpu_gemm(const Dtype* output, const Dtype* weights, Dtype* input);
-	void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype *weights);
+	void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype *weights, const Dtype* col = NULL);
 	void backward_cpu_bias(Dtype* bias, const Dtype* input);
+	//	batched versions of the cpu gemms for ConvolutionLayer
+	//	im2col batch_size images into a [kernel_dim*group, batch_size*conv_out_spatial_dim] matrix
+	//	then a single gemm per group replaces batch_size small ones
+	//	bias/mask/weights_diff/input_diff can be NULL to skip them
+	//	col: same as above but in the batched layout
+	void forward_cpu_gemm_batched(const Dtype* input, const Dtype* weights, const Dtype* bias,
+		Dtype* output, unsigned char* mask, const int batch_size, Dtype* col = NULL);
+	void backward_cpu_gemm_batched(const Dtype* input, const Dtype* output_diff, const Dtype* weights,
+		Dtype* weights_diff, Dtype* input_diff, const int batch_size, const Dtype* col = NULL);
 	//	can not use STUB_GPU
 #ifndef CPU_ONLY
 	void forward_gpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output, bool skip_im2col = false);
@@ -47,24 +79,41 @@ protected:
 	void weight_gpu_gemm(const Dtype* input, const Dtype* output, Dtype *weights);
 #endif
 
+	Dtype* col_buffer_cpu(){
+		return (Dtype*)Workspace::Get().cpu(col_buffer_count*sizeof(Dtype));
+	}
+#ifndef CPU_ONLY
+	Dtype* col_buffer_gpu(){
+		return (Dtype*)Workspace::Get().gpu(col_buffer_count*sizeof(Dtype));
+	}
+#endif
+
 private:
 	//	wrap im2col using param in this class
 	//	data is 3D(channels,height,width), col_buff is 3D(channels
-	void conv_im2col_cpu(const Dtype* data, Dtype* col_buff){
-		// only implements conv2D
+	void conv_im2col_cpu(const Dtype* data, Dtype* col_buff, const int col_ld = 0){
+		//	conv2D uses the row-copy version
 		if (!force_nd_im2col&&num_spatial_axes == 2){
 			//	im2col transform the input into the form which is convenient for convolution
 			//	use conv_xxx cause dimensions could reverse in reshape(), we need dynamic input
 			im2col_cpu(data, conv_in_channels, conv_input_shape.cpu_data()[1], conv_input_shape.cpu_data()[2],
 				kernel_shape.cpu_data()[0], kernel_shape.cpu_data()[1], pad.cpu_data()[0], pad.cpu_data()[1],
-				stride.cpu_data()[0], stride.cpu_data()[1], col_buff);
+				stride.cpu_data()[0], stride.cpu_data()[1], col_buff, col_ld);
+		}
+		else{
+			im2col_nd_cpu(data, num_spatial_axes, conv_input_shape.cpu_data(), &col_buffer_shape[0],
+				kernel_shape.cpu_data(), pad.cpu_data(), stride.cpu_data(), col_buff, col_ld);
 		}
 	}
-	void conv_col2im_cpu(const Dtype* col_buff, Dtype* data){
+	void conv_col2im_cpu(const Dtype* col_buff, Dtype* data, const int col_ld = 0){
 		if (!force_nd_im2col&&num_spatial_axes == 2){
 			col2im_cpu(col_buff, conv_in_channels, conv_input_shape.cpu_data()[1], conv_input_shape.cpu_data()[2],
 				kernel_shape.cpu_data()[0], kernel_shape.cpu_data()[1], pad.cpu_data()[0], pad.cpu_data()[1],
-				stride.cpu_data()[0], stride.cpu_data()[1], data);
+				stride.cpu_data()[0], stride.cpu_data()[1], data, col_ld);
+		}
+		else{
+			col2im_nd_cpu(col_buff, num_spatial_axes, conv_input_shape.cpu_data(), &col_buffer_shape[0],
+				kernel_shape.cpu_data(), pad.cpu_data(), stride.cpu_data(), data, col_ld);
 		}
 	}
 #ifndef CPU_ONLY
@@ -2,11 +2,14 @@
 # define CONV_LAYER_HPP
 
 #include "base_conv_layer.hpp"
+#include "../../utils/winograd.hpp"
 
 template<typename Dtype>
 class ConvolutionLayer : public BaseConvolutionLayer < Dtype > {
 public:
 	ConvolutionLayer(const LayerParameter& param) :BaseConvolutionLayer<Dtype>(param) {}
+	virtual void layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
+	virtual void reshape(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 protected:
 	virtual void forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top);
 	virtual void backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
@@ -14,6 +17,29 @@ protected:
 	virtual void backward_gpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom);
 	virtual void computeOutputShape();
 	virtual bool reverseDimensions() { return false; }
+	//	WINOGRAD engine, see also utils/winograd.hpp
+	//	winograd_m: output tile size, 0 means the shape is unsupported and im2col is used
+	bool use_winograd;
+	int winograd_m, winograd_batch;
+	//	transformed weights for forward(0) and the data gradient(1)
+	//	cached until the weights are written again
+	Blob<Dtype> winograd_weights[2];
+	boost::shared_ptr<SyncedMemory> winograd_src[2];
+	unsigned int winograd_version[2];
+	const Dtype* winogradWeights(const bool flip);
+	void winograd_cpu(const Dtype* input, const Dtype* transformed, const int in_channels, const int in_height,
+		const int in_width, const int pad_h, const int pad_w, const int out_channels, Dtype* output);
+	//	columns of the first retained_images images of each bottom kept from forward
+	//	they are only used if the bottom data is not written after forward
+	int retained_images;
+	Blob<Dtype> retained_columns;
+	vector<boost::shared_ptr<SyncedMemory> > retained_src;
+	vector<unsigned int> retained_version;
+	//	NULL if images [n, n+batch_size) of the bottom are not(fully) retained
+	Dtype* retainedColumns(const int bottom_id, const int n, const int batch_size){
+		if (n + batch_size > retained_images) return NULL;
+		return retained_columns.mutable_cpu_data() + ((size_t)bottom_id*retained_images + n)*col_buffer_count;
+	}
 };
 
 template<typename Dtype>
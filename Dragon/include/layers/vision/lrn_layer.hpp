@@ -17,6 +17,12 @@ protected:
 	virtual void forward_gpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
 	virtual void backward_cpu(const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp, const vector<Blob<Dtype>*>& bottom);
 	virtual void backward_gpu(const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp, const vector<Blob<Dtype>*>& bottom);
+	virtual void CrossChannelForward(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+	virtual void CrossChannelBackward(const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp, const vector<Blob<Dtype>*>& bottom);
+	//	fused CPU kernel of WITHIN_CHANNEL
+	virtual void WithinChannelForward_cpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+	virtual void WithinChannelBackward_cpu(const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp, const vector<Blob<Dtype>*>& bottom);
+	//	WITHIN_CHANNEL by the layer chain below, which keeps the data on the GPU
 	virtual void WithinChannelForward(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
 	virtual void WithinChannelBackward(const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp, const vector<Blob<Dtype>*>& bottom);
 	int size_;
@@ -29,11 +35,13 @@ protected:
 	int height_;
 	int width_;
 
-	// Fields used for normalization ACROSS_CHANNELS
-	// scale_ stores the intermediate summing results
+	// scale_ stores the denominators before the power for both regions
+	// ACROSS_CHANNELS: k + alpha/size * (sum of squares over the channel window)
+	// WITHIN_CHANNEL: 1 + alpha/size^2 * (sum of squares over the spatial window)
+	// backward reuses it instead of computing again
 	Blob<Dtype> scale_;
 
-	// Fields used for normalization WITHIN_CHANNEL
+	// Fields used for normalization WITHIN_CHANNEL on GPU
 	boost::shared_ptr<SplitLayer<Dtype> > split_layer_;
 	vector<Blob<Dtype>*> split_top_vec_;
 	boost::shared_ptr<PowerLayer<Dtype> > square_layer_;
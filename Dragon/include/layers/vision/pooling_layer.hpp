@@ -2,6 +2,7 @@
 # define POOLING_LAYER_HPP
 
 #include "../../layer.hpp"
+#include "../../utils/pooling.hpp"
 
 template<typename Dtype>
 class PoolingLayer :public Layer < Dtype > {
@@ -22,6 +23,13 @@ protected:
 	bool global_pooling;
 	Blob<Dtype> rand_idx;
 	Blob<int> max_idx;
+	//	CPU kernel picked by reshape()
+	PoolingKernel pool_kernel;
+	//	CPU max pooling keeps a byte per output (the index inside the window) instead of max_idx
+	//	unless the window is too large or the mask goes to top[1]
+	//	so forward and backward must run on the same device
+	bool use_window_mask;
+	boost::shared_ptr<SyncedMemory> window_mask;
 };
 
 
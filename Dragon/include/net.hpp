@@ -3,12 +3,13 @@
 #include "common.hpp"
 #include "blob.hpp"
 #include "layer.hpp"
+#include "utils/memory_planner.hpp"
 template <typename Dtype>
 class Net{
 public:
 	Net(const NetParameter& param, const Net* root_net = NULL);
 	Net(const string& param_file, Phase phase, const Net* root_net = NULL);
-	virtual ~Net() {}
+	virtual ~Net();
 	static bool stateMeetRule(const NetState& state, const NetStateRule& rule, const string& name);
 	static void filterNet(const NetParameter& param,NetParameter* filtered_param);
 	void reshape(){
@@ -73,6 +74,11 @@ protected:
 	vector<vector<Blob<Dtype>*> > bottom_vecs;
 	vector<vector<int> > bottom_id_vecs;
 	vector<vector<bool> > bottoms_need_backward;
+	//	shape signature of bottoms: the number of bottoms, then num_axes and dims of each
+	//	forward skips reshape() of a layer while its signature is unchanged
+	vector<vector<int> > bottom_shapes;
+	//	compare with the signature and update it if changed
+	bool bottomShapesChanged(const int layer_id);
 	//	store for param
 	vector<Dtype> blobs_loss_weight;
 	vector<vector<int> > param_id_vecs;
@@ -97,6 +103,36 @@ protected:
 	int appendBottom(const NetParameter& param, const int layer_id, const int bottom_id,
 		std::set<string>* available_blobs, map<string, int>* blob_name_to_idx);
 	void appendParam(const NetParameter& param, const int layer_id, const int param_id);
+	//	memory planning
+	bool optimize_memory;
+	vector<boost::shared_ptr<SyncedMemory> > data_slots, diff_slots;
+	//	let activations with disjoint lifetimes share the memory
+	//	return the saved bytes
+	size_t planDataMemory();
+	//	the same for diffs of activations in backward
+	size_t planDiffMemory();
+	//	drop the diffs which layers allocated(e.g. by shareDiff() in reshape)
+	//	on the blobs that backward never reaches, return the freed bytes
+	size_t releaseUnusedDiffs();
+	//	inference folding
+	//	a folded layer is removed from the net and kept with its params
+	//	so the producer can be folded again after loading a trained model
+	struct FoldedLayer{
+		string producer;
+		LayerParameter param;
+		vector<boost::shared_ptr<Blob<Dtype> > > blobs;
+		bool in_place, loaded;
+	};
+	vector<FoldedLayer> folded_layers;
+	static bool foldableLayer(const LayerParameter& layer_param);
+	static bool foldTarget(const LayerParameter& layer_param);
+	//	remove the folded layers from param, the producers write their tops
+	void foldInference(const NetParameter& param, NetParameter* folded_param);
+	//	rewrite weight/bias of the producers in the folding order
+	void foldWeights(const set<string>& producers);
+	//	ReLU fusion
+	//	a ReLU after Convolution/InnerProduct runs in their bias epilogue(CPU only)
+	void fuseReLU(const NetParameter& param, NetParameter* fused_param);
 };
 
 
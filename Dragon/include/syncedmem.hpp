@@ -5,13 +5,20 @@
 #include <cstdlib>
 #include <cstring>
 #include "common.hpp"
+#include "utils/host_allocator.hpp"
 
-inline void dragonMalloc(void **ptr, size_t size){
-	*ptr = malloc(size);
+//	return the allocator which owns the block, free the block through it
+//	the installed allocator may be changed by HostAllocator::Set() in the meantime
+inline HostAllocator* dragonMalloc(void **ptr, size_t size){
+	HostAllocator* allocator = HostAllocator::Get();
+	*ptr = allocator->alloc(size);
 	CHECK(*ptr) << "host allocation of size " << size << " failed";
+	return allocator;
 }
-inline void dragonFree(void *ptr){
-	free(ptr);
+//	size is required by the caching allocator to find the size class
+inline void dragonFree(void *ptr, size_t size, HostAllocator* allocator = NULL){
+	if (!allocator) allocator = HostAllocator::Get();
+	allocator->dealloc(ptr, size);
 }
 inline void dragonMemset(void *ptr,size_t size){
 	memset(ptr, 0, size);
@@ -38,12 +45,15 @@ inline void dragonGpuMemcpy(void *dest, void* src, size_t size){
 class SyncedMemory
 {
 public:
-	SyncedMemory():cpu_ptr(NULL), gpu_ptr(NULL), size_(0), head_(UNINITIALIZED) {}
-	SyncedMemory(size_t size) :cpu_ptr(NULL), gpu_ptr(NULL), size_(size), head_(UNINITIALIZED) {}
+	SyncedMemory():cpu_ptr(NULL), gpu_ptr(NULL), size_(0), allocator(NULL),
+		own_cpu_data(false), own_gpu_data(false), head_(UNINITIALIZED), version_(0) {}
+	SyncedMemory(size_t size) :cpu_ptr(NULL), gpu_ptr(NULL), size_(size), allocator(NULL),
+		own_cpu_data(false), own_gpu_data(false), head_(UNINITIALIZED), version_(0) {}
 	void to_gpu();
 	void to_cpu();
 	const void* cpu_data();
 	const void* gpu_data();
+	//	data must be aligned to DRAGON_MALLOC_ALIGN as the allocated memory
 	void set_cpu_data(void *data);
 	void set_gpu_data(void *data);
 	void* mutable_cpu_data();
@@ -54,10 +64,18 @@ public:
 	enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
 	void *cpu_ptr, *gpu_ptr;
 	size_t size_;
+	//	the host allocator which made cpu_ptr
+	HostAllocator* allocator;
 	bool own_cpu_data, own_gpu_data;
 	SyncedHead head_;
+	//	bumped whenever the memory is handed out for writing
+	//	layers use it to cache something computed from the data(e.g. transformed weights)
+	unsigned int version_;
 	SyncedHead head() { return head_; }
+	unsigned int version() { return version_; }
 	size_t size() { return size_; }
+	//	whether the host buffer satisfies the alignment contract
+	bool is_aligned() { return dragonIsAligned(cpu_ptr); }
 	~SyncedMemory();
 };
 
@@ -0,0 +1,25 @@
+#ifndef ALIGN_HPP
+#define ALIGN_HPP
+
+#include <cstddef>
+
+//	alignment contract of all host buffers (must be a power of 2 and >= sizeof(void*))
+//	64 bytes covers a cache line and the widest SIMD load (AVX-512)
+//	override it from the compiler command line if necessary
+#ifndef DRAGON_MALLOC_ALIGN
+#define DRAGON_MALLOC_ALIGN 64
+#endif
+
+inline bool dragonIsAligned(const void* ptr, size_t align = DRAGON_MALLOC_ALIGN){
+	return ((size_t)ptr & (align - 1)) == 0;
+}
+
+//	tell the compiler a pointer is aligned, so it can emit aligned SIMD loads
+//	MSVC does not need it (unaligned loads on aligned addresses cost nothing)
+#if defined(__GNUC__)
+#define DRAGON_ASSUME_ALIGNED(type, ptr) ((type)__builtin_assume_aligned((ptr), DRAGON_MALLOC_ALIGN))
+#else
+#define DRAGON_ASSUME_ALIGNED(type, ptr) ((type)(ptr))
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+# ifndef DATUM_VIEW_HPP
+# define DATUM_VIEW_HPP
+
+#include <cstring>
+#include <vector>
+#include "common.hpp"
+using namespace std;
+
+//	a serialized Datum read in place(e.g. from the memory map of LMDB)
+//	the buffer must outlive the view, LMDB keeps it valid until the read txn ends
+//	the header is parsed at the first access, so the reader thread only hands out pointers
+//	data/float_data stay in the buffer, the pixels are copied once: into the batch
+class DatumView{
+public:
+	//	a borrowed bytes field, indexed like the string of Datum
+	class Bytes{
+	public:
+		Bytes() :ptr(NULL), len(0) {}
+		const char* data() const { return ptr; }
+		size_t size() const { return len; }
+		const char& operator[](const size_t i) const { return ptr[i]; }
+	private:
+		friend class DatumView;
+		const char* ptr;
+		size_t len;
+	};
+	DatumView() { reset(NULL, 0); }
+	void reset(const char* buffer, const size_t size);
+	void swap(DatumView& other);
+	int channels() const { parse(); return channels_; }
+	int height() const { parse(); return height_; }
+	int width() const { parse(); return width_; }
+	int label() const { parse(); return label_; }
+	bool encoded() const { parse(); return encoded_; }
+	const Bytes& data() const { parse(); return data_; }
+	int float_data_size() const { parse(); return float_count; }
+	//	packed floats are read unaligned from the buffer(little-endian as the wire format)
+	float float_data(const int i) const{
+		parse();
+		if (!unpacked.empty()) return unpacked[i];
+		float val;
+		memcpy(&val, float_data_.ptr + i*sizeof(float), sizeof(float));
+		return val;
+	}
+private:
+	void parse() const{ if (!parsed) parseHeader(); }
+	void parseHeader() const;
+	const char* buffer;
+	size_t size;
+	//	filled by parseHeader()
+	mutable bool parsed, encoded_;
+	mutable int channels_, height_, width_, label_, float_count;
+	mutable Bytes data_, float_data_;
+	//	float_data written without packing can not be a span
+	mutable vector<float> unpacked;
+};
+
+# endif
@@ -10,9 +10,14 @@ public:
 	Cursor() {}
 	virtual ~Cursor() {}
 	virtual void SeekToFirst() = 0;
+	//	the first key >= key
+	virtual void SeekTo(const string& key) = 0;
 	virtual void Next() = 0;
 	virtual string key() = 0;
 	virtual string value() = 0;
+	//	the value in place, valid until the cursor is destroyed
+	virtual const char* valueData() = 0;
+	virtual size_t valueSize() = 0;
 	virtual bool valid() = 0;
 };
 class Transaction{
@@ -29,6 +34,8 @@ public:
 	virtual ~DB() {}
 	virtual void Open(const string& source, Mode mode) = 0;
 	virtual void Close() = 0;
+	//	the number of records
+	virtual size_t Count() = 0;
 	virtual Cursor* NewCursor() = 0;
 	virtual Transaction* NewTransaction() = 0;
 
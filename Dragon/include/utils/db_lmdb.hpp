@@ -16,6 +16,11 @@ public:
 		mdb_txn_abort(mdb_txn);
 	}
 	virtual void SeekToFirst(){ Seek(MDB_FIRST); }
+	virtual void SeekTo(const string& key){
+		mdb_key.mv_data = (void*)key.data();
+		mdb_key.mv_size = key.size();
+		Seek(MDB_SET_RANGE);
+	}
 	virtual void Next() { Seek(MDB_NEXT); }
 	virtual string key(){
 		return string((const char*)mdb_key.mv_data, mdb_key.mv_size);
@@ -23,6 +28,9 @@ public:
 	virtual string value(){
 		return string((const char*)mdb_val.mv_data, mdb_val.mv_size);
 	}
+	//	points into the memory map, the read txn is held until the destructor
+	virtual const char* valueData() { return (const char*)mdb_val.mv_data; }
+	virtual size_t valueSize() { return mdb_val.mv_size; }
 	virtual bool valid() { return valid_; }
 private:
 	void Seek(MDB_cursor_op op){
@@ -58,6 +66,7 @@ public:
 			mdb_env = NULL;
 		}
 	}
+	virtual size_t Count();
 	virtual LMDBCursor* NewCursor();
 	virtual LMDBTransaction* NewTransaction();
 private:
@@ -0,0 +1,27 @@
+# ifndef DEPTHWISE_HPP
+# define DEPTHWISE_HPP
+
+//	direct depthwise convolution(group == channels) for a single image
+//	each input channel owns multiplier output channels and their kernels
+//	weights are [channels*multiplier, 1, kernel_h, kernel_w] as in ConvolutionLayer
+//	the inner loops run along the output rows so they can be vectorized for stride 1
+
+//	out is overwritten
+template<typename Dtype>
+void depthwise_conv_cpu(const Dtype* im, const int channels, const int height, const int width,
+	const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const Dtype* weights, Dtype* out);
+
+//	im_diff is overwritten
+template<typename Dtype>
+void depthwise_conv_backward_data_cpu(const Dtype* out_diff, const int channels, const int height, const int width,
+	const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const Dtype* weights, Dtype* im_diff);
+
+//	weights_diff is accumulated
+template<typename Dtype>
+void depthwise_conv_backward_weights_cpu(const Dtype* im, const Dtype* out_diff, const int channels,
+	const int height, const int width, const int multiplier, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* weights_diff);
+
+# endif
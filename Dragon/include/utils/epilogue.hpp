@@ -0,0 +1,27 @@
+# ifndef EPILOGUE_HPP
+# define EPILOGUE_HPP
+
+//	CPU epilogues of Convolution/InnerProduct
+//	bias and a fused ReLU(with negative_slope) are applied in one pass
+//	right after a gemm has produced a tile, while it is still in the cache
+//	mask: 1 where the pre-activation > 0, kept for backward (NULL to skip)
+
+//	channels rows of spatial_dim, bias[c] is broadcast over the c_th row (NCHW)
+//	the c_th row of src starts at src+c*src_ld, dst/mask are contiguous
+//	bias can be NULL, src can be dst
+template <typename Dtype>
+void bias_relu_cpu(const int channels, const int spatial_dim, const Dtype* src, const int src_ld,
+	const Dtype* bias, const bool relu, const Dtype slope, Dtype* dst, unsigned char* mask);
+
+//	rows of dim, bias is broadcast over the rows (the output of InnerProduct)
+template <typename Dtype>
+void bias_relu_rows_cpu(const int rows, const int dim, const Dtype* bias,
+	const bool relu, const Dtype slope, Dtype* data, unsigned char* mask);
+
+//	diff *= 1 or slope, taken from mask or from the sign of the activation if mask is NULL
+//	the latter needs slope >= 0
+template <typename Dtype>
+void relu_backward_cpu(const int count, const unsigned char* mask, const Dtype* data,
+	const Dtype slope, Dtype* diff);
+
+# endif
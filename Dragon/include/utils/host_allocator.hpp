@@ -0,0 +1,100 @@
+#ifndef HOST_ALLOCATOR_HPP
+#define HOST_ALLOCATOR_HPP
+
+#include <cstdlib>
+#include <vector>
+#include <boost/atomic.hpp>
+#include "common.hpp"
+#include "align.hpp"
+
+//	all host memory of SyncedMemory comes from here through dragonMalloc/dragonFree
+//	the backend is pluggable, install your own one with HostAllocator::Set()
+
+//	raw aligned allocation, used by the allocators
+void* dragonAlignedMalloc(size_t size);
+void dragonAlignedFree(void* ptr);
+
+struct HostAllocatorStats{
+	HostAllocatorStats() :hits(0), misses(0), bytes_held(0), bytes_in_use(0) {}
+	//	allocations served from the cache / from the system
+	size_t hits, misses;
+	//	bytes kept by the cache for reusing / bytes handed out and not freed yet
+	size_t bytes_held, bytes_in_use;
+};
+
+class HostAllocator{
+public:
+	virtual ~HostAllocator() {}
+	virtual void* alloc(size_t size) = 0;
+	//	size must be the same as the one passed to alloc()
+	virtual void dealloc(void* ptr, size_t size) = 0;
+	//	give all cached memory back to the system
+	virtual void release() {}
+	virtual HostAllocatorStats stats() { return HostAllocatorStats(); }
+	static HostAllocator* Get();
+	//	not thread-safe, install it before starting any working threads
+	//	blocks are freed by the allocator which allocated them(see dragonMalloc)
+	//	so the replaced allocator must outlive its blocks, the default one is never deleted
+	//	returned memory must be aligned to DRAGON_MALLOC_ALIGN
+	static void Set(HostAllocator* allocator);
+};
+
+//	the plain allocator, forward to the system every time
+class SystemHostAllocator :public HostAllocator{
+public:
+	virtual void* alloc(size_t size);
+	virtual void dealloc(void* ptr, size_t size);
+};
+
+//	size-class caching allocator
+//	Blob::reshape and the prefetching threads allocate and free buffers with
+//	the same few sizes again and again, recycle them instead of hitting malloc
+//	sizes are rounded up to quarter-power-of-two classes (waste <= 25%)
+//	each thread keeps a small magazine per class which needs no locking,
+//	full magazines spill into the global depot (one mutex per class)
+//	so buffers freed by the solver thread can be picked up by the prefetching threads
+class CachingHostAllocator :public HostAllocator{
+public:
+	//	cache_limit: max bytes held by the cache, 0 means unlimited
+	//	the default one keeps the peak of a few reshapes without holding on to all of them
+	static const size_t DEFAULT_CACHE_LIMIT = (size_t)512 << 20;
+	CachingHostAllocator(size_t cache_limit = DEFAULT_CACHE_LIMIT);
+	virtual ~CachingHostAllocator();
+	virtual void* alloc(size_t size);
+	virtual void dealloc(void* ptr, size_t size);
+	virtual void release();
+	virtual HostAllocatorStats stats();
+	void setCacheLimit(size_t limit) { cache_limit = limit; }
+	size_t getCacheLimit() { return cache_limit; }
+	//	blocks less than 64 bytes share the smallest class
+	//	blocks larger than 1GB are not cached
+	static const int MIN_CLASS_SHIFT = 6;
+	static const int MAX_CLASS_SHIFT = 30;
+	static const int NUM_CLASSES = (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT) * 4 + 1;
+	//	max blocks per class in a thread's magazine
+	static const int MAGAZINE_SIZE = 4;
+	static int sizeToClass(size_t size);
+	static size_t classToSize(int idx);
+	class Magazine{
+	public:
+		Magazine(CachingHostAllocator* allocator) :allocator(allocator) {}
+		CachingHostAllocator* allocator;
+		vector<void*> blocks[NUM_CLASSES];
+	};
+private:
+	class Depot{
+	public:
+		boost::mutex mutex;
+		vector<void*> blocks;
+	};
+	Magazine* magazine();
+	//	move cached blocks of the magazine into the depot
+	void flush(Magazine* mag, int idx, size_t keep);
+	static void flushMagazine(Magazine* mag);
+	Depot depots[NUM_CLASSES];
+	boost::thread_specific_ptr<Magazine> magazines;
+	size_t cache_limit;
+	boost::atomic<size_t> hits, misses, bytes_held, bytes_in_use;
+};
+
+#endif
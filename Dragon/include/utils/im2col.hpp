@@ -1,15 +1,38 @@
 # ifndef IM2COL_HPP
 # define IM2COL_HPP
 
+#include <algorithm>
+
+//	output columns [lo, hi) whose input column x*stride - pad + offset stays inside [0, width)
+inline void im2colRange(const int width, const int out_width, const int pad, const int stride,
+	const int offset, int& lo, int& hi){
+	lo = pad > offset ? (pad - offset + stride - 1) / stride : 0;
+	const int last = width - 1 + pad - offset;
+	hi = last < 0 ? 0 : std::min(out_width, last / stride + 1);
+}
+
+//	col_ld: the distance between two rows of col, 0 means col_h*col_w
+//	a larger col_ld lets several images be patched side by side into one matrix
 template<typename Dtype>
 void im2col_cpu(const Dtype* im, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* col);
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* col,
+	const int col_ld = 0);
 
 template<typename Dtype>
 void col2im_cpu(const Dtype* col, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* im);
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* im,
+	const int col_ld = 0);
+
+//	N-D version, im_shape: (channels, spatial...), col_shape: (channels*kernel_size, out_spatial...)
+template<typename Dtype>
+void im2col_nd_cpu(const Dtype* im, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, Dtype* col, const int col_ld = 0);
+
+template<typename Dtype>
+void col2im_nd_cpu(const Dtype* col, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, Dtype* im, const int col_ld = 0);
 
 template<typename Dtype>
 void im2col_gpu(const Dtype* im, const int channels, const int height, const int width,
@@ -18,6 +18,13 @@ void dragon_cpu_gemm(const CBLAS_TRANSPOSE transA, const CBLAS_TRANSPOSE transB,
 	const int M, const int N, const int K, const Dtype alpha, const Dtype* A, const Dtype* B,
 	const Dtype beta, Dtype *C);
 
+//	C_i=alpha*A_i*B_i+beta*C_i for i in [0,batch_count)
+//	A_i=A+i*stride_a, and so on
+template<typename Dtype>
+void dragon_cpu_gemm_strided_batched(const CBLAS_TRANSPOSE transA, const CBLAS_TRANSPOSE transB,
+	const int M, const int N, const int K, const Dtype alpha, const Dtype* A, const int stride_a,
+	const Dtype* B, const int stride_b, const Dtype beta, Dtype *C, const int stride_c, const int batch_count);
+
 //	y=alpha*A*x+beta*y
 template<typename Dtype>
 void dragon_cpu_gemv(const CBLAS_TRANSPOSE transA, const int M, const int N, const Dtype alpha,
@@ -41,6 +48,11 @@ void dragon_rng_gaussian(const int N, const Dtype mu, const Dtype sigma, Dtype*
 template <typename Dtype>
 void dragon_rng_bernoulli(const int N, const Dtype p, unsigned int* x);
 
+//	bit i of bits[i/32] is 1 with probability p, (N+31)/32 words are written
+//	generated by Philox blocks in parallel, the result does not depend on the thread count
+template <typename Dtype>
+void dragon_rng_bernoulli_bits(const int N, const Dtype p, unsigned int* bits);
+
 template <typename Dtype>
 void dragon_exp(const int N, const Dtype* x, Dtype* y);
 
@@ -0,0 +1,37 @@
+#ifndef MEMORY_PLANNER_HPP
+#define MEMORY_PLANNER_HPP
+
+#include <vector>
+#include <cstddef>
+using namespace std;
+
+//	assign buffers with lifetimes to shared slots
+//	a lifetime is a closed interval of steps(e.g. layer ids) while the buffer is alive
+//	buffers in the same slot never overlap, so peak memory drops from the sum of
+//	all buffers to roughly the widest set of buffers alive at the same time
+class MemoryPlanner{
+public:
+	MemoryPlanner() {}
+	//	return the request id
+	int add(int first, int last, size_t size);
+	//	greedy best-fit: larger buffers first, each takes the smallest free slot
+	void plan();
+	int numSlots() const { return slot_sizes.size(); }
+	int slot(int request_id) const { return slots[request_id]; }
+	size_t slotSize(int slot_id) const { return slot_sizes[slot_id]; }
+	//	bytes of all requests/slots
+	size_t requestedSize() const;
+	size_t plannedSize() const;
+private:
+	struct Request{
+		int first, last;
+		size_t size;
+	};
+	bool overlap(int slot_id, const Request& request) const;
+	vector<Request> requests;
+	vector<int> slots;
+	vector<size_t> slot_sizes;
+	vector<vector<int> > slot_requests;
+};
+
+#endif
@@ -1,13 +1,23 @@
 #ifndef MKL_ALTERNATIVE_HPP
 #define MKL_ALTERNATIVE_HPP
 
+#include "align.hpp"
 
 // functions that dragon uses but are not present if MKL is not linked.
 // use for(...) and cmath avoid it
+// host buffers are aligned to DRAGON_MALLOC_ALIGN, take the aligned loop when
+// all pointers are (offsets into a Blob may be not)
 #define DEFINE_VSL_UNARY_FUNC(name, operation) \
   template<typename Dtype> \
-  void v##name(const int n, const Dtype* a, Dtype* y) { \
-    for (int i = 0; i < n; ++i) { operation; } \
+  void v##name(const int n, const Dtype* a_, Dtype* y_) { \
+    if (dragonIsAligned(a_) && dragonIsAligned(y_)) { \
+      const Dtype* a = DRAGON_ASSUME_ALIGNED(const Dtype*, a_); \
+      Dtype* y = DRAGON_ASSUME_ALIGNED(Dtype*, y_); \
+      for (int i = 0; i < n; ++i) { operation; } \
+    } else { \
+      const Dtype* a = a_; Dtype* y = y_; \
+      for (int i = 0; i < n; ++i) { operation; } \
+    } \
 	    } \
   inline void vs##name( \
     const int n, const float* a, float* y) { \
@@ -20,8 +30,15 @@
 
 #define DEFINE_VSL_UNARY_FUNC_WITH_PARAM(name, operation) \
   template<typename Dtype> \
-  void v##name(const int n, const Dtype* a, const Dtype b, Dtype* y) { \
-    for (int i = 0; i < n; ++i) { operation; } \
+  void v##name(const int n, const Dtype* a_, const Dtype b, Dtype* y_) { \
+    if (dragonIsAligned(a_) && dragonIsAligned(y_)) { \
+      const Dtype* a = DRAGON_ASSUME_ALIGNED(const Dtype*, a_); \
+      Dtype* y = DRAGON_ASSUME_ALIGNED(Dtype*, y_); \
+      for (int i = 0; i < n; ++i) { operation; } \
+    } else { \
+      const Dtype* a = a_; Dtype* y = y_; \
+      for (int i = 0; i < n; ++i) { operation; } \
+    } \
   } \
   inline void vs##name( \
     const int n, const float* a, const float b, float* y) { \
@@ -34,8 +51,16 @@
 
 #define DEFINE_VSL_BINARY_FUNC(name, operation) \
   template<typename Dtype> \
-  void v##name(const int n, const Dtype* a, const Dtype* b, Dtype* y) { \
-    for (int i = 0; i < n; ++i) { operation; } \
+  void v##name(const int n, const Dtype* a_, const Dtype* b_, Dtype* y_) { \
+    if (dragonIsAligned(a_) && dragonIsAligned(b_) && dragonIsAligned(y_)) { \
+      const Dtype* a = DRAGON_ASSUME_ALIGNED(const Dtype*, a_); \
+      const Dtype* b = DRAGON_ASSUME_ALIGNED(const Dtype*, b_); \
+      Dtype* y = DRAGON_ASSUME_ALIGNED(Dtype*, y_); \
+      for (int i = 0; i < n; ++i) { operation; } \
+    } else { \
+      const Dtype* a = a_; const Dtype* b = b_; Dtype* y = y_; \
+      for (int i = 0; i < n; ++i) { operation; } \
+    } \
   } \
   inline void vs##name( \
     const int n, const float* a, const float* b, float* y) { \
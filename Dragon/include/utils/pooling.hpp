@@ -0,0 +1,48 @@
+# ifndef POOLING_HPP
+# define POOLING_HPP
+
+//	CPU max/avg pooling over num_planes consecutive (n,c) planes
+//	the common windows get specialized kernels: the interior outputs are computed
+//	row by row with the kernel loops outside, so the inner loops run along the output row
+//	and can be vectorized, the outputs touching the padding go through the generic window
+//	the max mask is compact: the index of the max inside its window,
+//	(h - start_h)*kernel_w + (w - start_w) with the unclipped start,
+//	so the window can not be larger than 256 elements
+
+enum PoolingKernel{
+	POOLING_GENERIC, POOLING_2X2_S2, POOLING_3X3_S2, POOLING_3X3_S1, POOLING_GLOBAL
+};
+
+//	pick the kernel once in reshape()
+PoolingKernel select_pooling_kernel(const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const bool global_pooling);
+
+//	the largest window which fits the compact mask
+static const int POOLING_MAX_MASK_WINDOW = 256;
+
+//	out/mask are overwritten
+template<typename Dtype>
+void max_pool_cpu(const PoolingKernel kernel, const Dtype* in, const int num_planes, const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* out, unsigned char* mask);
+
+//	the area counts the padding inside height+pad_h/width+pad_w
+template<typename Dtype>
+void avg_pool_cpu(const PoolingKernel kernel, const Dtype* in, const int num_planes, const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* out);
+
+//	in_diff is accumulated
+template<typename Dtype>
+void max_pool_backward_cpu(const PoolingKernel kernel, const Dtype* out_diff, const unsigned char* mask,
+	const int num_planes, const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* in_diff);
+
+template<typename Dtype>
+void avg_pool_backward_cpu(const PoolingKernel kernel, const Dtype* out_diff, const int num_planes,
+	const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* in_diff);
+
+# endif
@@ -0,0 +1,198 @@
+#ifndef RING_QUEUE_HPP
+#define RING_QUEUE_HPP
+
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "common.hpp"
+using namespace std;
+
+//	bounded lock-free rings for the hot queues of the data pipeline
+//	BlockingQueue takes a lock and may wake a futex for every element,
+//	the rings only touch two indices and wake nobody while the other side is awake
+//	the capacity is rounded up to a power of 2
+//	push/pop spin a short while and then park, the parking is a boost interruption point
+//	so the threads blocked in them can still be stopped by DragonThread::stopThread()
+
+//	an index on its own cache line, the producer and the consumer do not share lines
+struct RingIndex{
+	boost::atomic<size_t> val;
+	char pad[64 - sizeof(boost::atomic<size_t>)];
+};
+
+//	spin-then-park waiting of one side of a ring
+//	notify() only takes the mutex if somebody is parked
+class RingWaiter{
+public:
+	RingWaiter() { waiters = 0; }
+	//	spin iterations before parking
+	static const int SPIN_COUNT = 1 << 10;
+	//	wait until done() returns true, done() also does the operation
+	template <typename Done>
+	void wait(Done done, const string& log_waiting_msg = ""){
+		for (int i = 0; i < SPIN_COUNT; i++) if (done()) return;
+		boost::mutex::scoped_lock lock(mutex);
+		Parked parked(&waiters);
+		//	parked is published before done() reads the ring, see notify()
+		while (!done()){
+			if (!log_waiting_msg.empty()){ LOG_EVERY_N(INFO, 1000) << log_waiting_msg; }
+			condition.wait(lock);
+		}
+	}
+	void notify(){
+		//	the element is published before waiters is read
+		//	so either the waiter sees the element or the notifier sees the waiter
+		boost::atomic_thread_fence(boost::memory_order_seq_cst);
+		if (waiters.load(boost::memory_order_relaxed) == 0) return;
+		boost::mutex::scoped_lock lock(mutex);
+		condition.notify_all();
+	}
+private:
+	//	also leaves when the wait is interrupted
+	struct Parked{
+		Parked(boost::atomic<int>* waiters) :waiters(waiters) { waiters->fetch_add(1); }
+		~Parked() { waiters->fetch_sub(1); }
+		boost::atomic<int>* waiters;
+	};
+	boost::atomic<int> waiters;
+	boost::mutex mutex;
+	boost::condition_variable condition;
+};
+
+inline size_t ring_capacity(const int capacity){
+	CHECK_GT(capacity, 0);
+	size_t size = 1;
+	while (size < capacity) size <<= 1;
+	return size;
+}
+
+//	one producer thread and one consumer thread
+template <typename T>
+class SPSCRing{
+public:
+	explicit SPSCRing(const int capacity) :mask(ring_capacity(capacity) - 1){
+		cells = new T[mask + 1];
+		head.val = 0;
+		tail.val = 0;
+	}
+	~SPSCRing() { delete[] cells; }
+	bool try_push(const T& t){
+		const size_t pos = tail.val.load(boost::memory_order_relaxed);
+		if (pos - head.val.load(boost::memory_order_acquire) > mask) return false;
+		cells[pos & mask] = t;
+		tail.val.store(pos + 1, boost::memory_order_release);
+		return true;
+	}
+	bool try_pop(T* t){
+		const size_t pos = head.val.load(boost::memory_order_relaxed);
+		if (pos == tail.val.load(boost::memory_order_acquire)) return false;
+		*t = cells[pos & mask];
+		head.val.store(pos + 1, boost::memory_order_release);
+		return true;
+	}
+	bool try_peek(T* t){
+		const size_t pos = head.val.load(boost::memory_order_relaxed);
+		if (pos == tail.val.load(boost::memory_order_acquire)) return false;
+		*t = cells[pos & mask];
+		return true;
+	}
+	void push(const T& t){
+		if (!try_push(t)) not_full.wait([&]{ return try_push(t); });
+		not_empty.notify();
+	}
+	T pop(const string& log_waiting_msg = ""){
+		T t;
+		if (!try_pop(&t)) not_empty.wait([&]{ return try_pop(&t); }, log_waiting_msg);
+		not_full.notify();
+		return t;
+	}
+	//	the consumer side, or any thread before the consumer starts
+	T peek(){
+		T t;
+		if (!try_peek(&t)) not_empty.wait([&]{ return try_peek(&t); });
+		return t;
+	}
+	size_t size() const{
+		return tail.val.load(boost::memory_order_acquire) - head.val.load(boost::memory_order_acquire);
+	}
+private:
+	RingIndex head, tail;
+	const size_t mask;
+	T* cells;
+	RingWaiter not_empty, not_full;
+};
+
+//	any number of producers and consumers
+//	every cell carries a sequence number which tells its round(D. Vyukov's bounded queue)
+template <typename T>
+class MPMCRing{
+public:
+	explicit MPMCRing(const int capacity) :mask(ring_capacity(capacity) - 1){
+		cells = new Cell[mask + 1];
+		for (size_t i = 0; i <= mask; i++) cells[i].seq = i;
+		head.val = 0;
+		tail.val = 0;
+	}
+	~MPMCRing() { delete[] cells; }
+	bool try_push(const T& t){
+		size_t pos = tail.val.load(boost::memory_order_relaxed);
+		Cell* cell;
+		for (;;){
+			cell = &cells[pos & mask];
+			const ptrdiff_t diff = (ptrdiff_t)cell->seq.load(boost::memory_order_acquire) - (ptrdiff_t)pos;
+			//	free in this round, claim it
+			if (diff == 0){
+				if (tail.val.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) break;
+			}
+			//	still holds the element of the last round
+			else if (diff < 0) return false;
+			else pos = tail.val.load(boost::memory_order_relaxed);
+		}
+		cell->data = t;
+		cell->seq.store(pos + 1, boost::memory_order_release);
+		return true;
+	}
+	bool try_pop(T* t){
+		size_t pos = head.val.load(boost::memory_order_relaxed);
+		Cell* cell;
+		for (;;){
+			cell = &cells[pos & mask];
+			const ptrdiff_t diff = (ptrdiff_t)cell->seq.load(boost::memory_order_acquire) - (ptrdiff_t)(pos + 1);
+			if (diff == 0){
+				if (head.val.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) break;
+			}
+			//	not written yet
+			else if (diff < 0) return false;
+			else pos = head.val.load(boost::memory_order_relaxed);
+		}
+		*t = cell->data;
+		//	free for the next round
+		cell->seq.store(pos + mask + 1, boost::memory_order_release);
+		return true;
+	}
+	void push(const T& t){
+		if (!try_push(t)) not_full.wait([&]{ return try_push(t); });
+		not_empty.notify();
+	}
+	T pop(const string& log_waiting_msg = ""){
+		T t;
+		if (!try_pop(&t)) not_empty.wait([&]{ return try_pop(&t); }, log_waiting_msg);
+		not_full.notify();
+		return t;
+	}
+	//	approximate while both sides are running
+	size_t size() const{
+		return tail.val.load(boost::memory_order_acquire) - head.val.load(boost::memory_order_acquire);
+	}
+private:
+	struct Cell{
+		boost::atomic<size_t> seq;
+		T data;
+	};
+	RingIndex head, tail;
+	const size_t mask;
+	Cell* cells;
+	RingWaiter not_empty, not_full;
+};
+
+#endif
@@ -1,7 +1,48 @@
 #ifndef RNG_HPP
 #define RNG_HPP
 #include "../common.hpp"
+#include <boost/cstdint.hpp>
 #include <boost/random/mersenne_twister.hpp>
 using namespace boost;
 typedef boost::mt19937 rng_t;
+
+//	Philox4x32-10 (Salmon et al. "Parallel random numbers: as easy as 1, 2, 3")
+//	a counter-based generator: block i is a bijection of (i, key)
+//	so blocks can be generated in any order, on any thread, with the same result
+//	the key is drawn from the thread's rng_t, which keeps set_random_seed() reproducible
+static const uint32_t PHILOX_M0 = 0xD2511F53, PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9, PHILOX_W1 = 0xBB67AE85;
+//	blocks computed together, the lanes are independent so the rounds vectorize
+static const int PHILOX_LANES = 8;
+
+//	blocks [counter, counter+PHILOX_LANES), out[j][l] is the j_th word of the l_th block
+inline void philox4x32(const uint64_t counter, const uint64_t key, uint32_t out[4][PHILOX_LANES]){
+	uint32_t c0[PHILOX_LANES], c1[PHILOX_LANES], c2[PHILOX_LANES], c3[PHILOX_LANES];
+	for (int l = 0; l < PHILOX_LANES; l++){
+		const uint64_t ctr = counter + l;
+		c0[l] = (uint32_t)ctr;
+		c1[l] = (uint32_t)(ctr >> 32);
+		c2[l] = c3[l] = 0;
+	}
+	uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+	for (int round = 0; round < 10; round++){
+		for (int l = 0; l < PHILOX_LANES; l++){
+			const uint64_t p0 = (uint64_t)PHILOX_M0*c0[l], p1 = (uint64_t)PHILOX_M1*c2[l];
+			const uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[l] ^ k0;
+			const uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[l] ^ k1;
+			c1[l] = (uint32_t)p1;
+			c3[l] = (uint32_t)p0;
+			c0[l] = n0;
+			c2[l] = n2;
+		}
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	for (int l = 0; l < PHILOX_LANES; l++){
+		out[0][l] = c0[l];
+		out[1][l] = c1[l];
+		out[2][l] = c2[l];
+		out[3][l] = c3[l];
+	}
+}
 #endif
@@ -0,0 +1,75 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "common.hpp"
+
+//	intra-op pool for the CPU kernels, owned by the thread-local Dragon
+//	so every solver/prefetching thread has its own one
+//	parallelFor() splits [begin,end) into a range per participant (the caller included)
+//	each participant takes grain-sized chunks from the front of its own range
+//	and steals chunks from the other ranges when it runs out
+//	a job only takes as many workers as it has ranges beyond the caller's one
+//	workers spin a short while after a job and then sleep on a condition,
+//	so the cores are given back to OpenBLAS between the parallel regions and the gemms
+//	do not call BLAS inside a parallel region, it may oversubscribe the cores
+class ThreadPool{
+public:
+	//	num_threads counts the caller, so num_threads-1 workers are started
+	//	bind_cores: pin the workers to consecutive cores, the caller is left alone
+	//	every binding pool starts after the cores taken by the former ones
+	ThreadPool(int num_threads, bool bind_cores = false);
+	~ThreadPool();
+	int size() const { return num_workers + 1; }
+	//	fn(lo, hi) is called for disjoint chunks which cover [begin, end)
+	//	chunks are grain long except the last one of each range
+	void parallelFor(int begin, int end, int grain, const boost::function<void(int, int)>& fn);
+	//	true on the worker threads, and on the caller while it is running a job
+	//	nested parallelFor calls run serially
+	static bool inParallel();
+	//	spin iterations before a worker goes to sleep
+	static const int SPIN_COUNT = 1 << 14;
+private:
+	//	padded to a cache line, the participants hammer on different ranges
+	struct Range{
+		boost::atomic<int> next;
+		int end;
+		char pad[64 - sizeof(boost::atomic<int>) - sizeof(int)];
+	};
+	void workerLoop(int id);
+	//	drain the own range and then steal from the others
+	void run(int id);
+	int num_workers;
+	bool bind_cores;
+	//	the core of the first worker
+	int core_base;
+	boost::thread_group workers;
+	Range* ranges;
+	int num_ranges;
+	//	the current job, published by bumping the generation
+	const boost::function<void(int, int)>* job;
+	int grain;
+	boost::atomic<unsigned int> generation;
+	//	participants still to be claimed by the workers / not finished yet
+	boost::atomic<int> slots, pending;
+	bool stop;
+	boost::mutex mutex;
+	boost::condition_variable job_cond, done_cond;
+};
+
+//	run fn over [begin, end) with the pool of the calling thread's Dragon
+//	falls back to a single call if the range fits a grain, the pool is disabled
+//	or it is called inside a parallel region
+void dragon_parallel_for(int begin, int end, int grain, const boost::function<void(int, int)>& fn);
+
+//	grain for items which cost work_per_item elements each
+//	a chunk should carry enough work to pay for waking a worker up
+inline int dragon_parallel_grain(int work_per_item){
+	const int min_work = 1 << 15;
+	if (work_per_item <= 0) return min_work;
+	return max(1, min_work / work_per_item);
+}
+
+#endif
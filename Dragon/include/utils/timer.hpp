@@ -0,0 +1,20 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+//	wall clock timer for the benchmarks
+class Timer{
+public:
+	Timer() { start(); }
+	void start() { start_time = boost::posix_time::microsec_clock::local_time(); }
+	//	elapsed time since start()
+	double microSeconds(){
+		return (double)(boost::posix_time::microsec_clock::local_time() - start_time).total_microseconds();
+	}
+	double milliSeconds() { return microSeconds() / 1000.0; }
+private:
+	boost::posix_time::ptime start_time;
+};
+
+#endif
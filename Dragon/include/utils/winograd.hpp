@@ -0,0 +1,32 @@
+# ifndef WINOGRAD_HPP
+# define WINOGRAD_HPP
+
+#include <cstddef>
+
+//	Winograd minimal filtering F(m x m, 3 x 3) for stride-1 3x3 convolution
+//	see Lavin & Gray, "Fast Algorithms for Convolutional Neural Networks"
+//	a tile of (m+2)x(m+2) input pixels produces mxm output pixels
+//	with (m+2)^2 element-wise products instead of 9*m^2 multiply-adds
+//	the products of all tiles and channels become (m+2)^2 independent gemms
+//	only m=2 and m=4 are supported
+
+//	transformed weights are stored as [(m+2)^2, out_channels, in_channels]
+//	flip: transform the 180-degree rotated kernels with in/out swapped([(m+2)^2, in_channels, out_channels])
+//	which turns the data gradient of a convolution into another convolution
+template<typename Dtype>
+void winograd_transform_weights(const Dtype* weights, const int out_channels, const int in_channels,
+	const int m, const bool flip, Dtype* transformed);
+
+//	elements of the workspace needed by winograd_conv_cpu
+size_t winograd_workspace_count(const int num, const int channels, const int out_channels,
+	const int out_height, const int out_width, const int m);
+
+//	num images of [channels, height, width] => num images of [out_channels, out_height, out_width]
+//	out_height = height + 2*pad_h - 2, out_width = width + 2*pad_w - 2
+//	the output is overwritten but not accumulated
+template<typename Dtype>
+void winograd_conv_cpu(const Dtype* im, const int num, const int channels, const int height, const int width,
+	const int pad_h, const int pad_w, const Dtype* transformed, const int out_channels, const int m,
+	Dtype* out, Dtype* workspace);
+
+# endif
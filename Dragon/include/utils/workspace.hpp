@@ -0,0 +1,36 @@
+#ifndef WORKSPACE_HPP
+#define WORKSPACE_HPP
+
+#include "common.hpp"
+#include "syncedmem.hpp"
+
+//	scratch memory shared by all layers running in the same thread
+//	layers run one after another, so e.g. the im2col buffers of all conv layers
+//	can live in one buffer sized to the largest request instead of one per layer
+//	contents are only valid until the next layer borrows the workspace
+class Workspace{
+public:
+	//	the workspace of the current thread
+	static Workspace& Get();
+	//	grow-only, the returned pointer is invalidated by a larger request
+	void* cpu(size_t size);
+	void* gpu(size_t size);
+	//	grow in advance(e.g. in Layer::reshape), so forward/backward never reallocate
+	void reserve(size_t size) { reserved = max(reserved, size); }
+	size_t cpuSize() { return cpu_buffer ? cpu_buffer->size() : 0; }
+	size_t gpuSize() { return gpu_buffer ? gpu_buffer->size() : 0; }
+	//	free the buffers
+	void release();
+	//	nets of the thread register themselves, so the buffers sized for them
+	//	are freed when the last one is destroyed
+	void attach() { users++; }
+	void detach() { if (--users <= 0) { users = 0; release(); } }
+private:
+	Workspace() :reserved(0), users(0) {}
+	//	keep cpu/gpu in two memories, scratch needs no synchronization between them
+	boost::shared_ptr<SyncedMemory> cpu_buffer, gpu_buffer;
+	size_t reserved;
+	int users;
+};
+
+#endif
@@ -17,7 +17,7 @@ void Blob<Dtype>::reshape(const BlobShape& blob_shape) {
 }
 
 template<typename Dtype>
-void Blob<Dtype>::reshape(vector<int> shape){
+void Blob<Dtype>::reshape(const vector<int>& shape){
 	count_ = 1;
 	shape_.resize(shape.size());
 	for (int i = 0; i < shape.size(); ++i) {
@@ -29,7 +29,8 @@ void Blob<Dtype>::reshape(vector<int> shape){
 	if (count_ > capacity_) {
 		capacity_ = count_;
 		data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
-		diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+		//	allocate lazily, see allocDiff()
+		diff_.reset();
 	}
 }
 
@@ -64,13 +65,13 @@ void Blob<Dtype>::set_gpu_data(Dtype *data){
 
 template<typename Dtype>
 const Dtype* Blob<Dtype>::cpu_diff() const{
-	CHECK(diff_);
+	allocDiff();
 	return (const Dtype*)diff_->cpu_data();
 }
 
 template<typename Dtype>
 const Dtype* Blob<Dtype>::gpu_diff()const {
-	CHECK(diff_);
+	allocDiff();
 	return (const Dtype*)diff_->gpu_data();
 }
 
@@ -88,13 +89,13 @@ Dtype* Blob<Dtype>::mutable_gpu_data(){
 
 template<typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_diff(){
-	CHECK(diff_);
+	allocDiff();
 	return (Dtype*)diff_->mutable_cpu_data();
 }
 
 template<typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_diff(){
-	CHECK(diff_);
+	allocDiff();
 	return (Dtype*)diff_->mutable_gpu_data();
 }
 template<> void Blob<unsigned int>::update() { NOT_IMPLEMENTED; }
@@ -221,10 +222,12 @@ void Blob<Dtype>::ToProto(BlobProto* proto, bool write_diff){
 	//do not use proto->shape() cause it is a const method
 	for (int i = 0; i < shape_.size(); i++)  proto->mutable_shape()->add_dim(shape_[i]);
 	const Dtype *data = cpu_data();
-	const Dtype *diff = cpu_diff();
 	for (int i = 0; i < count_; i++)  proto->add_data(data[i]);
-	if (write_diff)
+	//	do not touch the diff if not need
+	if (write_diff){
+		const Dtype *diff = cpu_diff();
 		for (int i = 0; i < count_; i++)  proto->add_diff(diff[i]);
+	}
 }
 
 
@@ -1,4 +1,5 @@
 #include "common.hpp"
+#include "utils/thread_pool.hpp"
 
 //	using _getpid() with MSVC,and #include <process.h>
 #include <process.h>
@@ -23,10 +24,36 @@ int64_t Dragon::cluster_seedgen(){
 	return seed;
 }
 
+static int defaultNumThreads(){
+	return max(1, (int)boost::thread::hardware_concurrency());
+}
+
+void Dragon::set_num_threads(int num_threads, bool set_blas){
+	CHECK_GE(num_threads, 1);
+	Get().num_threads = num_threads;
+	//	rebuild it at the next use
+	Get().thread_pool.reset();
+	if (set_blas) openblas_set_num_threads(num_threads);
+}
+
+void Dragon::set_thread_affinity(bool val){
+	Get().thread_affinity = val;
+	Get().thread_pool.reset();
+}
+
+ThreadPool* Dragon::get_thread_pool(){
+	Dragon& dragon = Get();
+	if (dragon.num_threads <= 1) return NULL;
+	if (!dragon.thread_pool)
+		dragon.thread_pool.reset(new ThreadPool(dragon.num_threads, dragon.thread_affinity));
+	return dragon.thread_pool.get();
+}
+
 #ifdef CPU_ONLY
 //	implements for CPU Manager
 Dragon::Dragon():
-	mode(Dragon::CPU), solver_count(1), root_solver(true) {}
+	mode(Dragon::CPU), solver_count(1), root_solver(true),
+	num_threads(defaultNumThreads()), thread_affinity(false) {}
 Dragon::~Dragon() { }
 void Dragon::set_device(const int device_id) {}
 void Dragon::set_random_seed(const unsigned int seed) {Get().random_generator.reset(new RNG(seed));}
@@ -50,6 +77,7 @@ void Dragon::set_random_seed(const unsigned int seed) {
 }
 Dragon::Dragon() :
 	mode(Dragon::CPU), solver_count(1), root_solver(true),
+	num_threads(defaultNumThreads()), thread_affinity(false),
 	cublas_handle(NULL), curand_generator(NULL){
 	if (cublasCreate_v2(&cublas_handle) != CUBLAS_STATUS_SUCCESS)
 		LOG(ERROR) << "Couldn't create cublas handle.";
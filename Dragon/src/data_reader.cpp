@@ -28,14 +28,14 @@ DataReader::~DataReader(){
 	if (global_bodies[hash_key].expired()) global_bodies.erase(hash_key);
 }
 
-QueuePair::QueuePair(const int size){
+QueuePair::QueuePair(const int size) :free(size), full(size){
 	// set the upbound for a producter
-	for (int i = 0; i < size; i++) free.push(new Datum());
+	for (int i = 0; i < size; i++) free.push(new DatumView());
 }
 
 QueuePair::~QueuePair(){
 	// release and clear
-	Datum *datum;
+	DatumView *datum;
 	while (free.try_pop(&datum)) delete datum;
 	while (full.try_pop(&datum)) delete datum;
 }
@@ -54,11 +54,10 @@ Body::~Body() {
 
 void Body::read_one(Cursor *cursor, QueuePair *pair){
 	//	could block here when pre-buffer enough Datum
-	Datum *datum = pair->free.pop();
+	DatumView *datum = pair->free.pop();
 	//	LMDB<string,string>
-	//	Google Buffer Protocol can decode string
-	//	it can be done much quicker than SQL method(e.g. SQLite)
-	datum->ParseFromString(cursor->value());
+	//	no copy and no decoding here, the transformer parses the header in place
+	datum->reset(cursor->valueData(), cursor->valueSize());
 	pair->full.push(datum);
 	cursor->Next();
 	//	until stop training, we need read data circularly
@@ -72,6 +71,10 @@ void Body::read_one(Cursor *cursor, QueuePair *pair){
 void Body::interfaceKernel(){
 	boost::shared_ptr<DB> db(GetDB(param.data_param().backend()));
 	db->Open(param.data_param().source(), DB::READ);
+	if (param.data_param().readers() > 1){
+		read_sharded(db.get());
+		return;
+	}
 	boost::shared_ptr<Cursor> cursor(db->NewCursor());
 	try{
 		//	default solver_count=1
@@ -84,3 +87,83 @@ void Body::interfaceKernel(){
 		//  complex condition
 	} catch (boost::thread_interrupted&) {}
 }
+
+void Body::read_sharded(DB *db){
+	const size_t entries = db->Count();
+	CHECK_GT(entries, 0) << "Specified DB is empty.";
+	const int num_shards = (int)min<size_t>(param.data_param().readers(), entries);
+	//	split the keys into contiguous ranges of the same size
+	//	walking the keys once is cheap, the values are not touched
+	vector<string> begin_keys(num_shards);
+	vector<size_t> counts(num_shards);
+	{
+		boost::shared_ptr<Cursor> cursor(db->NewCursor());
+		size_t idx = 0;
+		for (int i = 0; i < num_shards; i++){
+			const size_t begin = entries*i / num_shards, end = entries*(i + 1) / num_shards;
+			for (; idx < begin; idx++) cursor->Next();
+			CHECK(cursor->valid());
+			begin_keys[i] = cursor->key();
+			counts[i] = end - begin;
+		}
+	}
+	const bool strict = param.data_param().reader_order() == DataParameter_ReaderOrder_STRICT;
+	const int capacity = max(1, (int)(param.data_param().prefech()*param.data_param().batch_size() / num_shards));
+	//	declared before the shards, which are stopped first
+	//	the shards push their ids concurrently, at most one for each Datum
+	MPMCRing<int> ready(capacity*num_shards);
+	vector<boost::shared_ptr<ShardReader> > shards;
+	for (int i = 0; i < num_shards; i++){
+		//	cursors are created here one by one, LMDB forbids opening DBIs concurrently
+		shards.push_back(boost::shared_ptr<ShardReader>(new ShardReader(
+			db->NewCursor(), begin_keys[i], counts[i], capacity, i, strict ? NULL : &ready)));
+		shards[i]->startThread();
+	}
+	DLOG(INFO) << "Reading " << entries << " records with " << num_shards << " readers.";
+	try{
+		int solver_count = param.phase() == TRAIN ? Dragon::get_solver_count() : 1;
+		int next = 0;
+		while (!must_stop()){
+			for (int i = 0; i < solver_count; i++){
+				ShardReader *shard = shards[strict ? next : ready.pop()].get();
+				next = (next + 1) % num_shards;
+				DatumView *read = shard->pair.full.pop();
+				QueuePair *pair = new_pairs[i].get();
+				DatumView *datum = pair->free.pop();
+				//	the old view returns to the shard
+				datum->swap(*read);
+				pair->full.push(datum);
+				shard->pair.free.push(read);
+			}
+		}
+	}
+	catch (boost::thread_interrupted&) {}
+}
+
+ShardReader::ShardReader(Cursor *cursor, const string& begin_key, const size_t count,
+	const int capacity, const int id, MPMCRing<int> *ready) :
+	pair(capacity), cursor(cursor), begin_key(begin_key), count(count), id(id), ready(ready) {}
+
+ShardReader::~ShardReader(){
+	stopThread();
+}
+
+void ShardReader::interfaceKernel(){
+	try{
+		cursor->SeekTo(begin_key);
+		size_t idx = 0;
+		while (!must_stop()){
+			DatumView *datum = pair.free.pop();
+			datum->reset(cursor->valueData(), cursor->valueSize());
+			pair.full.push(datum);
+			if (ready) ready->push(id);
+			//	restart from the own range instead of the DB
+			if (++idx == count){
+				idx = 0;
+				cursor->SeekTo(begin_key);
+			}
+			else cursor->Next();
+		}
+	}
+	catch (boost::thread_interrupted&) {}
+}
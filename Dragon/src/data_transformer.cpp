@@ -27,6 +27,16 @@ DataTransformer<Dtype>::DataTransformer(const  TransformationParameter& param, P
 
 template<typename Dtype>
 vector<int> DataTransformer<Dtype>::inferBlobShape(const Datum& datum){
+	return inferDatumShape(datum);
+}
+
+template<typename Dtype>
+vector<int> DataTransformer<Dtype>::inferBlobShape(const DatumView& datum){
+	return inferDatumShape(datum);
+}
+
+template<typename Dtype> template <typename DatumType>
+vector<int> DataTransformer<Dtype>::inferDatumShape(const DatumType& datum){
 	const int crop_size = param.crop_size();
 	const int channels = datum.channels();
 	const int height = datum.height();
@@ -43,54 +53,89 @@ vector<int> DataTransformer<Dtype>::inferBlobShape(const Datum& datum){
 
 template<typename Dtype>
 void DataTransformer<Dtype>::initRand(){
-	const bool must_rand = (phase == TRAIN && param.crop_size());
+	//	mirror draws in both phases
+	const bool must_rand = param.mirror() || (phase == TRAIN && param.crop_size());
 	if (must_rand){
 		//thread-independent and fixed random-seed
-		const unsigned int rng_seed = Dragon::get_random_value();
+		rng_seed = Dragon::get_random_value();
 		ptr_rng.reset(new Dragon::RNG(rng_seed));
 	}
 }
 
+template<typename Dtype>
+boost::shared_ptr<Dragon::RNG> DataTransformer<Dtype>::forkRand(const int stream) const{
+	if (!ptr_rng) return boost::shared_ptr<Dragon::RNG>();
+	//	scatter the seeds with the golden ratio, mt19937 decorrelates near seeds itself
+	const unsigned int seed = rng_seed ^ (0x9E3779B9u * (unsigned int)(stream + 1));
+	return boost::shared_ptr<Dragon::RNG>(new Dragon::RNG(seed));
+}
+
 template<typename Dtype>
 int DataTransformer<Dtype>::rand(int n){
 	CHECK(ptr_rng);
+	return rand(n, ptr_rng->get_rng());
+}
+
+template<typename Dtype>
+int DataTransformer<Dtype>::rand(int n, rng_t* rng){
+	CHECK(rng);
 	CHECK_GT(n, 0);
-	rng_t* rng = ptr_rng->get_rng();
 	return (*rng)() % n;
 }
 
-//	copy the datum to the
 template<typename Dtype>
 void DataTransformer<Dtype>::transform(const Datum& datum, Dtype* shadow_data){
+	transformDatum(datum, shadow_data, ptr_rng ? ptr_rng->get_rng() : NULL);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::transform(const Datum& datum, Dtype* shadow_data, rng_t* rng){
+	transformDatum(datum, shadow_data, rng);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::transform(const DatumView& datum, Dtype* shadow_data){
+	transformDatum(datum, shadow_data, ptr_rng ? ptr_rng->get_rng() : NULL);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::transform(const DatumView& datum, Dtype* shadow_data, rng_t* rng){
+	transformDatum(datum, shadow_data, rng);
+}
+
+//	copy the datum to the
+template<typename Dtype> template <typename DatumType>
+void DataTransformer<Dtype>::transformDatum(const DatumType& datum, Dtype* shadow_data, rng_t* rng){
 	//	pixel can be compressed as a string
 	//	cause each pixel ranges from 0~255 (a char)
-	const string& data = datum.data();
+	const char* data = datum.data().data();
 	const int datum_channels = datum.channels();
 	const int datum_height = datum.height();
 	const int datum_width = datum.width();
 	const int crop_size = param.crop_size();
 	const Dtype scale = param.scale();
-	const bool need_mirror = param.mirror() && rand(2); // random mirrow
+	const bool need_mirror = param.mirror() && rand(2, rng); // random mirrow
 	const bool has_mean_file = param.has_mean_file();
-	const bool has_uint8 = data.size() > 0;		//	pixels are compressed as a string
+	const bool has_uint8 = datum.data().size() > 0;		//	pixels are compressed as a string
 	const bool has_mean_value = mean_vals.size() > 0;
 	CHECK_GT(datum_channels, 0);
 	CHECK_GE(datum_height, crop_size);
 	CHECK_GE(datum_width, crop_size);
-	Dtype *mean = NULL;
+	//	the pixels may be read in place, do not run out of the record
+	if (has_uint8) CHECK_GE(datum.data().size(), (size_t)datum_channels*datum_height*datum_width);
+	else CHECK_GE(datum.float_data_size(), datum_channels*datum_height*datum_width);
+	const Dtype *mean = NULL;
 	if (has_mean_file){
 		CHECK_EQ(datum_channels, mean_blob.channels());
 		CHECK_EQ(datum_height, mean_blob.height());
 		CHECK_EQ(datum_width, mean_blob.width());
-		mean = mean_blob.mutable_cpu_data();
+		mean = mean_blob.cpu_data();
 	}
+	//	a single value is broadcast over channels(read-only, workers share the transformer)
+	const bool single_mean = mean_vals.size() == 1;
 	if (has_mean_value){
-		CHECK(mean_vals.size() == 1 || mean_vals.size() == datum_channels)
+		CHECK(single_mean || mean_vals.size() == datum_channels)
 			<< "Channel's mean value must be provided as a single value or as many as channels.";
-		//replicate
-		if (datum_channels > 1 && mean_vals.size() == 1)
-			for (int i = 0; i < datum_channels - 1; i++)
-				mean_vals.push_back(mean_vals[0]);
 	}
 	int h_off = 0, w_off = 0, height = datum_height, width = datum_width;
 	if (crop_size){
@@ -98,8 +143,8 @@ void DataTransformer<Dtype>::transform(const Datum& datum, Dtype* shadow_data){
 		width = crop_size;
 		//	train phase using random croping
 		if (phase == TRAIN){
-			h_off = rand(datum_height - height + 1);
-			w_off = rand(datum_width - width + 1);
+			h_off = rand(datum_height - height + 1, rng);
+			w_off = rand(datum_width - width + 1, rng);
 		}
 		//	test phase using expected croping
 		else{
@@ -107,6 +152,8 @@ void DataTransformer<Dtype>::transform(const Datum& datum, Dtype* shadow_data){
 			w_off = (datum_width - width) / 2;
 		}
 	}
+	//	the prefetching thread runs it without an intra-op pool
+	//	the images of a batch are spread over the transform workers instead(see transform_workers)
 	Dtype element;
 	int top_idx, data_idx;
 	//copy datum values to shadow_data-> batch
@@ -123,7 +170,7 @@ void DataTransformer<Dtype>::transform(const Datum& datum, Dtype* shadow_data){
 				}
 				else element = datum.float_data(data_idx);	//Dtype <- float
 				if (has_mean_file) shadow_data[top_idx] = (element - mean[data_idx])*scale;
-				else if (has_mean_value) shadow_data[top_idx] = (element - mean_vals[c])*scale;
+				else if (has_mean_value) shadow_data[top_idx] = (element - mean_vals[single_mean ? 0 : c])*scale;
 				else shadow_data[top_idx] = element*scale;
 			}
 		}
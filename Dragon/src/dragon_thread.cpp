@@ -8,7 +8,8 @@ using namespace std;
 //	get-->set is not a repeated action, get_func called by parent thread
 //	where set_func called by children thread, they sharing different Dragon Manager
 
-void DragonThread::initializeThread(int device, Dragon::Mode mode, int rand_seed, int solver_count, bool root_solver){
+void DragonThread::initializeThread(int device, Dragon::Mode mode, int rand_seed, int solver_count, bool root_solver,
+	int num_threads, bool thread_affinity){
 #ifndef CPU_ONLY
 	CUDA_CHECK(cudaSetDevice(device));
 #endif
@@ -16,6 +17,8 @@ void DragonThread::initializeThread(int device, Dragon::Mode mode, int rand_seed
 	Dragon::set_mode(mode);
 	Dragon::set_solver_count(solver_count);
 	Dragon::set_root_solver(root_solver);
+	Dragon::set_num_threads(num_threads, false);
+	Dragon::set_thread_affinity(thread_affinity);
 	interfaceKernel();  //do nothing
 }
 
@@ -32,9 +35,13 @@ void DragonThread::startThread(){
 	unsigned int seed = Dragon::get_random_value();
 	int solver_count = Dragon::get_solver_count();
 	bool root_solver = Dragon::get_root_solver();
+	//	the child threads prefetch and read, they do not run the layers
+	//	a full intra-op pool for each of them would oversubscribe the cores of the solver
+	int num_threads = 1;
+	bool thread_affinity = Dragon::get_thread_affinity();
 	try{
 		thread.reset(new boost::thread(&DragonThread::initializeThread,
-							this, device, mode, seed, solver_count, root_solver));
+							this, device, mode, seed, solver_count, root_solver, num_threads, thread_affinity));
 	}
 	catch (std::exception& e){ LOG(FATAL) << "Thread exception: " << e.what(); }
 
@@ -1,4 +1,5 @@
 #include "layers/common/batch_norm.hpp"
+#include "utils/thread_pool.hpp"
 
 template <typename Dtype>
 void BatchNormLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
@@ -43,7 +44,8 @@ void BatchNormLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, const ve
 	shape.push_back(channels);
 	mean.reshape(shape);
 	var.reshape(shape);
-	//	temp blob for storing
+	//	temp blob for storing, the GPU path and in-place CPU training only
+	//	SyncedMemory allocates them at the first use
 	temp.reshapeLike(*bottom[0]);
 	expand_var.reshapeLike(*bottom[0]);
 	x_norm.reshapeLike(*bottom[0]);
@@ -70,144 +72,142 @@ void BatchNormLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, const ve
 }
 
 
+//	CPU kernels are fused per channel and never touch temp/expand_var/num_by_channels
+//	so those activation-sized blobs are not allocated in CPU mode
+//	var keeps sqrt(var+eps) as the GPU path does
 template <typename Dtype>
 void BatchNormLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
-	const Dtype* bottom_data = bottom[0]->mutable_cpu_data();
+	const Dtype* bottom_data = bottom[0]->cpu_data();
+	const Dtype* beta_data = blobs[0]->cpu_data();
+	const Dtype* gamma_data = blobs[1]->cpu_data();
+	Dtype* mean_data = mean.mutable_cpu_data();
+	Dtype* std_data = var.mutable_cpu_data();
+	const int batch_size = bottom[0]->shape(0);
+	const int spatial_dim = bottom[0]->count() / (channels*batch_size);
+	const int grain = dragon_parallel_grain(batch_size*spatial_dim);
+	// compute mean and var for this batch
+	if (phase == TRAIN || !use_global_stats){
+		//	one pass over a channel: each row gets its mean and M2 by two passes in the cache
+		//	and is merged into the channel's by Chan's formula, no E[x^2]-E[x]^2 cancellation
+		dragon_parallel_for(0, channels, grain, [&](int lo, int hi){
+			for (int c = lo; c < hi; c++){
+				Dtype channel_mean = 0, channel_m2 = 0;
+				int count = 0;
+				for (int n = 0; n < batch_size; n++){
+					const Dtype* row = bottom_data + (n*channels + c)*spatial_dim;
+					Dtype sum = 0;
+					for (int i = 0; i < spatial_dim; i++) sum += row[i];
+					const Dtype row_mean = sum / spatial_dim;
+					Dtype row_m2 = 0;
+					for (int i = 0; i < spatial_dim; i++) row_m2 += (row[i] - row_mean)*(row[i] - row_mean);
+					const Dtype delta = row_mean - channel_mean;
+					const int total = count + spatial_dim;
+					channel_mean += delta*spatial_dim / total;
+					channel_m2 += row_m2 + delta*delta*((Dtype)count*spatial_dim / total);
+					count = total;
+				}
+				mean_data[c] = channel_mean;
+				std_data[c] = sqrt(channel_m2 / count + eps);
+			}
+		});
+		//	store history mean and var
+		//	history=decay(0.95)*val+(1-decay)*histoty
+		dragon_cpu_axpby(channels, decay, mean.cpu_data(), Dtype(1) - decay, blobs[2]->mutable_cpu_data());
+		dragon_cpu_axpby(channels, decay, var.cpu_data(), Dtype(1) - decay, blobs[3]->mutable_cpu_data());
+	}
+	else if (phase == TEST&&use_global_stats){
+		// copy the history data
+		dragon_copy(channels, mean_data, blobs[2]->cpu_data());
+		dragon_copy(channels, std_data, blobs[3]->cpu_data());
+	}
+	//	in-place: bottom_data is overwritten, keep x_norm for backward
+	//	otherwise backward computes it again from the bottom
+	Dtype* x_norm_data = bottom[0] == top[0] && phase == TRAIN ? x_norm.mutable_cpu_data() : NULL;
 	Dtype* top_data = top[0]->mutable_cpu_data();
-	Dtype* beta_data = blobs[0]->mutable_cpu_data();
-	Dtype* gamma_data = blobs[1]->mutable_cpu_data();
-	int batch_size = bottom[0]->shape(0);
-	int spatial_dim = bottom[0]->count() / (channels*batch_size);
-	//	compute x^2 in temp
-	dragon_powx<Dtype>(bottom[0]->count(), bottom_data, Dtype(2), temp.mutable_cpu_data());
-	//	compute through all batches(sum each batch here)
-	//	var[x]=E[x^2]-(E[x])^2
-	//	sum all examples(batch_size*channels) for each dim(x)
-	dragon_cpu_gemv<Dtype>(CblasNoTrans, batch_size*channels, spatial_dim,
-		Dtype(1) / (batch_size*spatial_dim), bottom_data, spatial_sum_multiplier.cpu_data(),
-		Dtype(0), num_by_channels.mutable_cpu_data());
-	//	sum the whole batch to get the mean
-	dragon_cpu_gemv<Dtype>(CblasTrans, batch_size, channels,
-		Dtype(1), num_by_channels.cpu_data(), batch_sum_multiplier.cpu_data(),
-		Dtype(0), mean.mutable_cpu_data());
-	//	sum all examples(batch_size*channels) for each dim(x^2)
-	dragon_cpu_gemv<Dtype>(CblasNoTrans, batch_size*channels, spatial_dim,
-		Dtype(1) / (batch_size*spatial_dim), temp.cpu_data(), spatial_sum_multiplier.cpu_data(),
-		Dtype(0), num_by_channels.mutable_cpu_data());
-	//	sum the whole batch to get var(subtract after)
-	dragon_cpu_gemv<Dtype>(CblasTrans, batch_size, channels,
-		Dtype(1), num_by_channels.cpu_data(), batch_sum_multiplier.cpu_data(),
-		Dtype(0), var.mutable_cpu_data());
-
-	//	subtract and get the var
-	dragon_powx<Dtype>(mean.count(), mean.cpu_data(), Dtype(2), temp.mutable_cpu_data());
-	dragon_sub<Dtype>(var.count(), var.cpu_data(), temp.cpu_data(), var.mutable_cpu_data());
-	//	add eps
-	dragon_add_scalar(var.count(), eps, var.mutable_cpu_data());
-	//	sqrt
-	dragon_powx(var.count(), var.cpu_data(), Dtype(0.5), var.mutable_cpu_data());
-
-	//	check if do not use in-place method
-	//	we recommend use in-place like a activation function
-	dragon_copy<Dtype>(bottom[0]->count(), top_data, bottom_data);
-
-	//	subtract mean
-	//	copy the mean for all examples in a batch
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size, channels, 1,
-		Dtype(1), batch_sum_multiplier.cpu_data(), mean.cpu_data(), Dtype(0),
-		num_by_channels.mutable_cpu_data());
-	//	copy and subtract
-	//	if in conv layer, each feature map just subtract a mean value
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size*channels, spatial_dim, 1,
-		Dtype(-1), num_by_channels.cpu_data(), spatial_sum_multiplier.cpu_data(), Dtype(1),
-		top_data);
-
-	//	div std
-	//	expand
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size, channels, 1,
-		Dtype(1), batch_sum_multiplier.cpu_data(), var.cpu_data(), Dtype(0),
-		num_by_channels.mutable_cpu_data());
-	//	expand
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size*channels, spatial_dim, 1,
-		Dtype(1), num_by_channels.cpu_data(), spatial_sum_multiplier.cpu_data(), Dtype(0),
-		temp.mutable_cpu_data());
-	//	store sqrt(var+eps) for backward compution
-	dragon_copy<Dtype>(expand_var.count(), expand_var.mutable_cpu_data(), temp.cpu_data());
-
-	dragon_div(top[0]->count(), top_data, temp.cpu_data(), top_data);
-
-	//	store x_norm for backward compution
-	dragon_copy<Dtype>(x_norm.count(), x_norm.mutable_cpu_data(), top_data);
-
-	//	scale gamma
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size, channels, 1,
-		Dtype(1), batch_sum_multiplier.cpu_data(), gamma_data, Dtype(0),
-		num_by_channels.mutable_cpu_data());
-	//	expand
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size*channels, spatial_dim, 1,
-		Dtype(1), num_by_channels.cpu_data(), spatial_sum_multiplier.cpu_data(), Dtype(0),
-		temp.mutable_cpu_data());
-	dragon_mul(temp.count(), temp.cpu_data(), top_data, top_data);
-
-	//	shift beta
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size, channels, 1,
-		Dtype(1), batch_sum_multiplier.cpu_data(), beta_data, Dtype(0),
-		num_by_channels.mutable_cpu_data());
-	//	copy2
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size*channels, spatial_dim, 1,
-		Dtype(1), num_by_channels.cpu_data(), spatial_sum_multiplier.cpu_data(), Dtype(1),
-		top_data);
-
+	//	gamma*(x-mean)/std+beta, split over the (n,c) planes
+	dragon_parallel_for(0, batch_size*channels, dragon_parallel_grain(spatial_dim), [&](int lo, int hi){
+		for (int nc = lo; nc < hi; nc++){
+			const int c = nc % channels;
+			const Dtype mu = mean_data[c], inv_std = Dtype(1) / std_data[c];
+			const Dtype scale = gamma_data[c] * inv_std, shift = beta_data[c];
+			const Dtype* x = bottom_data + nc*spatial_dim;
+			Dtype* y = top_data + nc*spatial_dim;
+			if (x_norm_data){
+				Dtype* xn = x_norm_data + nc*spatial_dim;
+				for (int i = 0; i < spatial_dim; i++) xn[i] = (x[i] - mu)*inv_std;
+			}
+			for (int i = 0; i < spatial_dim; i++) y[i] = (x[i] - mu)*scale + shift;
+		}
+	});
 }
 
 template <typename Dtype>
 void BatchNormLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp,
 	const vector<Blob<Dtype>*> &bottom){
 	const Dtype *top_diff = top[0]->cpu_diff();
-	const Dtype* bottom_data = bottom[0]->cpu_data();
-	const Dtype* gamma_data = blobs[1]->mutable_cpu_data();
-	const Dtype* beta_data = blobs[0]->mutable_cpu_data();
-	Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+	const Dtype* gamma_data = blobs[1]->cpu_data();
+	const Dtype* mean_data = mean.cpu_data();
+	const Dtype* std_data = var.cpu_data();
+	//	x_norm is only kept by an in-place forward
+	const bool in_place = bottom[0] == top[0];
+	CHECK(!in_place || phase == TRAIN) << "in-place BatchNorm keeps x_norm for backward in TRAIN only.";
+	const Dtype* bottom_data = in_place ? NULL : bottom[0]->cpu_data();
+	const Dtype* x_norm_data = in_place ? x_norm.cpu_data() : NULL;
+	Dtype* bottom_diff = data_need_bp[0] ? bottom[0]->mutable_cpu_diff() : NULL;
 	Dtype* beta_diff = blobs[0]->mutable_cpu_diff();
 	Dtype* gamma_diff = blobs[1]->mutable_cpu_diff();
-	int batch_size = bottom[0]->shape(0);
-	int spatial_dim = bottom[0]->count() / (channels*batch_size);
-	/*****    compute param_diff     *****/
-
-	//	top_diff*x_norm
-	dragon_mul(temp.count(), x_norm.cpu_data(), top_diff, temp.mutable_cpu_data());
-	//	shrink by spatial_dim
-	dragon_cpu_gemv<Dtype>(CblasNoTrans, batch_size*channels, spatial_dim,
-		Dtype(1), temp.cpu_data(), spatial_sum_multiplier.cpu_data(), Dtype(0),
-		num_by_channels.mutable_cpu_data());
-	//	shrink by batch_size and get gamma_diff
-	dragon_cpu_gemv<Dtype>(CblasTrans, batch_size, channels,
-		Dtype(1), num_by_channels.cpu_data(), batch_sum_multiplier.cpu_data(), Dtype(0), gamma_diff);
-
-	//	shrink top_diff by spatial dim
-	dragon_cpu_gemv<Dtype>(CblasNoTrans, batch_size*channels, spatial_dim,
-		Dtype(1), top_diff, spatial_sum_multiplier.cpu_data(), Dtype(0),
-		num_by_channels.mutable_cpu_data());
-	//	shrink top_diff by batch_size and get beta_diff
-	dragon_cpu_gemv<Dtype>(CblasTrans, batch_size, channels,
-		Dtype(1), num_by_channels.cpu_data(), batch_sum_multiplier.cpu_data(), Dtype(0), beta_diff);
-
-
-	/*****    compute x_norm_diff    *****/
-
-	//	expand gamma by batch_size
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size, channels, 1,
-		Dtype(1), batch_sum_multiplier.cpu_data(), gamma_data, Dtype(0),
-		num_by_channels.mutable_cpu_data());
-
-	//	expand gamma by spatial_dim in temp
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, batch_size*channels, spatial_dim, 1,
-		Dtype(1), num_by_channels.cpu_data(), spatial_sum_multiplier.cpu_data(), Dtype(0),
-		temp.mutable_cpu_data());
-
-	//	compute x_norm_diff
-	dragon_mul<Dtype>(temp.count(), top_diff, temp.cpu_data(), x_norm.mutable_cpu_diff());
-
+	const int batch_size = bottom[0]->shape(0);
+	const int spatial_dim = bottom[0]->count() / (channels*batch_size);
+	//	m=batch_size*spatial_dim
+	const Dtype m = Dtype(batch_size*spatial_dim);
+	//	gamma_diff = sum(top_diff*x_norm), beta_diff = sum(top_diff)
+	//	bottom_diff = gamma/std * (top_diff - (beta_diff + x_norm*gamma_diff)/m)
+	//	two passes over a channel, no expanded gamma/mean/var
+	dragon_parallel_for(0, channels, dragon_parallel_grain(batch_size*spatial_dim), [&](int lo, int hi){
+		for (int c = lo; c < hi; c++){
+			const Dtype mu = mean_data[c], inv_std = Dtype(1) / std_data[c];
+			Dtype sum_dy = 0, sum_dy_xn = 0;
+			for (int n = 0; n < batch_size; n++){
+				const int offset = (n*channels + c)*spatial_dim;
+				const Dtype* dy = top_diff + offset;
+				if (in_place){
+					const Dtype* xn = x_norm_data + offset;
+					for (int i = 0; i < spatial_dim; i++){
+						sum_dy += dy[i];
+						sum_dy_xn += dy[i] * xn[i];
+					}
+				}
+				else{
+					const Dtype* x = bottom_data + offset;
+					for (int i = 0; i < spatial_dim; i++){
+						sum_dy += dy[i];
+						sum_dy_xn += dy[i] * (x[i] - mu)*inv_std;
+					}
+				}
+			}
+			beta_diff[c] = sum_dy;
+			gamma_diff[c] = sum_dy_xn;
+			if (!bottom_diff) continue;
+			const Dtype scale = gamma_data[c] * inv_std;
+			const Dtype mean_dy = sum_dy / m, mean_dy_xn = sum_dy_xn / m;
+			for (int n = 0; n < batch_size; n++){
+				const int offset = (n*channels + c)*spatial_dim;
+				const Dtype* dy = top_diff + offset;
+				Dtype* dx = bottom_diff + offset;
+				//	in-place: dx may be dy, each element is read before it is written
+				if (in_place){
+					const Dtype* xn = x_norm_data + offset;
+					for (int i = 0; i < spatial_dim; i++)
+						dx[i] = scale*(dy[i] - mean_dy - xn[i] * mean_dy_xn);
+				}
+				else{
+					const Dtype* x = bottom_data + offset;
+					for (int i = 0; i < spatial_dim; i++)
+						dx[i] = scale*(dy[i] - mean_dy - (x[i] - mu)*inv_std*mean_dy_xn);
+				}
+			}
+		}
+	});
 }
 
 INSTANTIATE_CLASS(BatchNormLayer);
\ No newline at end of file
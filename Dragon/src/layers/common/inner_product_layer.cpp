@@ -1,5 +1,8 @@
 #include "layers/common/inner_product_layer.hpp"
 
+//	an output tile of the epilogue fits the L2 cache
+static const size_t IP_EPILOGUE_TILE_BYTES = 256 << 10;
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
 	InnerProductParameter inner_product_param = param.inner_product_param();
@@ -30,6 +33,8 @@ void InnerProductLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom, co
 			bias_filler->fill(blobs[1].get());
 		}
 	}
+	fused_relu = param.has_fused_relu();
+	relu_slope = param.fused_relu().negative_slope();
 	param_need_bp.resize(blobs.size(), true);
 }
 
@@ -47,10 +52,16 @@ void InnerProductLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, const
 	top[0]->reshape(top_shape);
 	if (bias_term){
 		//	1D
-		vector<int> bias_multiplier_shape(1, M);
-		bias_multiplier.reshape(bias_multiplier_shape);
-		dragon_set(bias_multiplier.count(), Dtype(1), bias_multiplier.mutable_cpu_data());
+		if (bias_multiplier.count() != M){
+			vector<int> bias_multiplier_shape(1, M);
+			bias_multiplier.reshape(bias_multiplier_shape);
+			dragon_set(bias_multiplier.count(), Dtype(1), bias_multiplier.mutable_cpu_data());
+		}
 	}
+	if (fused_relu && phase == TRAIN){
+		if (!relu_mask || relu_mask->size() < top[0]->count()) relu_mask.reset(new SyncedMemory(top[0]->count()));
+	}
+	else relu_mask.reset();
 }
 
 template<typename Dtype>
@@ -62,25 +73,44 @@ void InnerProductLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom, c
 	//	we replace 'Wx+b' as 'xW+b' directly
 	//	it is different from conv_layer 
 	//	which use for(...) to handle a batch
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, N, K,
-		(Dtype)1.0, bottom_data, weights, (Dtype)0.0, top_data);
-	if (bias_term){
-		//	mul[batch_size,1] x bias_vector[1,num_output]=bias[batch_size,num_output]
-		//	top_data[batch_size,num_output] += bias[batch_size,num_output]
-		dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, 1,
-			(Dtype)1.0, bias_multiplier.cpu_data(), blobs[1]->cpu_data(), (Dtype)1.0, top_data);
+	if (!fused_relu){
+		dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, N, K,
+			(Dtype)1.0, bottom_data, weights, (Dtype)0.0, top_data);
+		if (bias_term){
+			//	mul[batch_size,1] x bias_vector[1,num_output]=bias[batch_size,num_output]
+			//	top_data[batch_size,num_output] += bias[batch_size,num_output]
+			dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, 1,
+				(Dtype)1.0, bias_multiplier.cpu_data(), blobs[1]->cpu_data(), (Dtype)1.0, top_data);
+		}
+		return;
+	}
+	//	with a fused ReLU the gemm goes in tiles of rows, each tile gets the bias/ReLU epilogue
+	//	while it is still in the cache, instead of a rank-1 gemm and a ReLU pass
+	const Dtype* bias = bias_term ? blobs[1]->cpu_data() : NULL;
+	unsigned char* mask = relu_mask ? (unsigned char*)relu_mask->mutable_cpu_data() : NULL;
+	const int tile = max(1, min(M, (int)(IP_EPILOGUE_TILE_BYTES / (N*sizeof(Dtype)))));
+	for (int m = 0; m < M; m += tile){
+		const int rows = min(tile, M - m);
+		dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, rows, N, K,
+			(Dtype)1.0, bottom_data + m*K, weights, (Dtype)0.0, top_data + m*N);
+		bias_relu_rows_cpu(rows, N, bias, fused_relu, relu_slope, top_data + m*N, mask ? mask + m*N : NULL);
 	}
 }
 
 template<typename Dtype>
 void InnerProductLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top, const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom){
 	const Dtype* top_diff = top[0]->cpu_diff();
+	//	diff of the pre-activations, written in place as an in-place ReLU does
+	if (fused_relu){
+		Dtype* relu_diff = top[0]->mutable_cpu_diff();
+		relu_backward_cpu(top[0]->count(), relu_mask ? (const unsigned char*)relu_mask->cpu_data() : NULL,
+			top[0]->cpu_data(), relu_slope, relu_diff);
+		top_diff = relu_diff;
+	}
 	const Dtype* bottom_data = bottom[0]->cpu_data();
 	const Dtype* weights = blobs[0]->cpu_data();
-	Dtype *weights_diff = blobs[0]->mutable_cpu_diff();
-	Dtype *bias_diff = blobs[1]->mutable_cpu_diff();
-	Dtype *bottom_diff = bottom[0]->mutable_cpu_diff();
 	if (param_need_bp[0]){
+		Dtype *weights_diff = blobs[0]->mutable_cpu_diff();
 
 		//	weight_diff += ( bottom_data*delta_(layer+1) )
 		//	use '+=' in Caffe because it will clear the diff per iter
@@ -93,12 +123,14 @@ void InnerProductLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top, con
 
 	}
 	if (bias_term && param_need_bp[1]){
+		Dtype *bias_diff = blobs[1]->mutable_cpu_diff();
 		//	bias_diff += delta_(layer+1)
 		//	note that gemv will choose the matrix' axis smartly
 		dragon_cpu_gemv<Dtype>(CblasTrans, M, N,
 			(Dtype)1.0, top_diff, bias_multiplier.cpu_data(), (Dtype)1.0, bias_diff);
 	}
 	if (data_need_bp[0]){
+		Dtype *bottom_diff = bottom[0]->mutable_cpu_diff();
 		//	bottom_diff += delta_(layer+1)*weights 
 		dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, K, N,
 			(Dtype)1.0, top_diff, weights, (Dtype)0.0, bottom_diff);
@@ -2,6 +2,7 @@
 
 template<typename Dtype>
 void InnerProductLayer<Dtype>::forward_gpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
+	CHECK(!fused_relu) << "The fused ReLU is only implemented on CPU, build the net with fuse_relu off to use GPU mode.";
 	const Dtype* bottom_data = bottom[0]->gpu_data();
 	Dtype *top_data = top[0]->mutable_gpu_data();
 	const Dtype* weights = blobs[0]->gpu_data();
@@ -25,10 +26,8 @@ void InnerProductLayer<Dtype>::backward_gpu(const vector<Blob<Dtype>*> &top, con
 	const Dtype* top_diff = top[0]->gpu_diff();
 	const Dtype* bottom_data = bottom[0]->gpu_data();
 	const Dtype* weights = blobs[0]->gpu_data();
-	Dtype *weights_diff = blobs[0]->mutable_gpu_diff();
-	Dtype *bias_diff = blobs[1]->mutable_gpu_diff();
-	Dtype *bottom_diff = bottom[0]->mutable_gpu_diff();
 	if (param_need_bp[0]){
+		Dtype *weights_diff = blobs[0]->mutable_gpu_diff();
 
 		//	weight_diff += ( bottom_data*delta_(layer+1) )
 		//	use '+=' in Caffe because it will clear the diff per iter
@@ -40,12 +39,14 @@ void InnerProductLayer<Dtype>::backward_gpu(const vector<Blob<Dtype>*> &top, con
 
 	}
 	if (bias_term && param_need_bp[1]){
+		Dtype *bias_diff = blobs[1]->mutable_gpu_diff();
 		//	bias_diff += delta_(layer+1)
 		//	note that gemv will choose the matrix' axis smartly
 		dragon_gpu_gemv<Dtype>(CblasTrans, M, N,
 			(Dtype)1.0, top_diff, bias_multiplier.gpu_data(), (Dtype)1.0, bias_diff);
 	}
 	if (data_need_bp[0]){
+		Dtype *bottom_diff = bottom[0]->mutable_gpu_diff();
 		//	bottom_diff += delta_(layer+1)*weights 
 		dragon_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, K, N,
 			(Dtype)1.0, top_diff, weights, (Dtype)0.0, bottom_diff);
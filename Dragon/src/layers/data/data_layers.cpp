@@ -20,7 +20,8 @@ void BaseDataLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*>& bottom, const
 
 template<typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(const LayerParameter& param) :
-BaseDataLayer<Dtype>(param), PREFETCH_COUNT(param.data_param().prefech()), reader(param){
+BaseDataLayer<Dtype>(param), PREFETCH_COUNT(param.data_param().prefech()), reader(param),
+free(param.data_param().prefech()), full(param.data_param().prefech()){
 	//	Blob is not initialized until reshape is called
 	//	which can be regarded as a containter in the queue here
 	CHECK_GT(PREFETCH_COUNT, 0) << "Prefetch num must greater than zero.";
@@ -33,19 +34,31 @@ void BasePrefetchingDataLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*>& bot
 	BaseDataLayer<Dtype>::layerSetup(bottom, top);
 	//	it will apply after calling DataLayer<Dtype>::dataLayerSetup
 	//	call mutable_ to malloc SyncedMemory cause reshape just calculate the malloc size
-	//	see also void Blob<Dtype>::reshape(vector<int> shape)
+	//	see also void Blob<Dtype>::reshape(const vector<int>& shape)
+	//	the storage of tops joins the prefetching cycle, see DataLayer::forward_cpu
 	for (int i = 0; i < PREFETCH_COUNT; i++){
 		prefetch[i].data.mutable_cpu_data();
 		if (has_labels) prefetch[i].label.mutable_cpu_data();
 	}
+	top[0]->mutable_cpu_data();
+	if (has_labels) top[1]->mutable_cpu_data();
 #ifndef CPU_ONLY
 	if (Dragon::get_mode() == Dragon::Mode::GPU){
 		for (int i = 0; i < PREFETCH_COUNT; i++){
 			prefetch[i].data.mutable_gpu_data();
 			if (has_labels) prefetch[i].label.mutable_gpu_data();
 		}
+		top[0]->mutable_gpu_data();
+		if (has_labels) top[1]->mutable_gpu_data();
 	}
 #endif
+	transform_workers = min<int>(param.data_param().transform_workers(), param.data_param().batch_size());
+	CHECK_GT(transform_workers, 0) << "Transform workers must greater than zero.";
+	if (transform_workers > 1){
+		transform_pool.reset(new ThreadPool(transform_workers));
+		for (int i = 0; i < transform_workers; i++)
+			worker_rngs.push_back(ptr_transformer->forkRand(i));
+	}
 	DLOG(INFO) << "Initializing Mutable Prefetch";
 	startThread();
 	DLOG(INFO) << "Prefetch Initialized";
@@ -61,9 +74,30 @@ void BasePrefetchingDataLayer<Dtype>::loadBatch(Batch<Dtype> *batch){
 	// it will share parts of a batch memory place, and transform directly in a batch
 	Dtype *base_data = batch->data.mutable_cpu_data();
 	Dtype *base_label = has_labels ? batch->label.mutable_cpu_data() : NULL;
+	if (transform_workers > 1){
+		//	take the whole batch in order first, the reader buffers prefech*batch_size datums
+		batch_datums.resize(batch_size);
+		for (int i = 0; i < batch_size; i++)
+			batch_datums[i] = reader.full().pop("Waiting for Datum data");
+		//	the w_th worker always takes the same slice with the same stream
+		//	so the batch does not depend on the scheduling
+		transform_pool->parallelFor(0, transform_workers, 1, [&](int lo, int hi){
+			for (int w = lo; w < hi; w++){
+				rng_t* rng = worker_rngs[w] ? worker_rngs[w]->get_rng() : NULL;
+				const int end = (long long)(w + 1)*batch_size / transform_workers;
+				for (int i = (long long)w*batch_size / transform_workers; i < end; i++){
+					//	the header of a view is parsed here, on the worker
+					if (has_labels) base_label[i] = batch_datums[i]->label();
+					ptr_transformer->transform(*batch_datums[i], base_data + batch->data.offset(i), rng);
+				}
+			}
+		});
+		for (int i = 0; i < batch_size; i++) reader.free().push(batch_datums[i]);
+		return;
+	}
 	for (int i = 0; i < batch_size; i++){
 		// must refer use '&' to keep data vaild(!!!important)
-		Datum &datum = *(reader.full().pop("Waiting for Datum data"));
+		DatumView &datum = *(reader.full().pop("Waiting for Datum data"));
 		int offset = batch->data.offset(i);
 		//	share a part of a blob memory 
 		//	transform datum and copy its value to the part of blob memory
@@ -112,7 +146,7 @@ template <typename Dtype>
 void DataLayer<Dtype>::dataLayerSetup(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
 	const int batch_size = param.data_param().batch_size();
 	//product 
-	Datum datum = *(reader.full().peek());
+	const DatumView& datum = *(reader.full().peek());
 	vector<int> topShape = ptr_transformer->inferBlobShape(datum);
 	topShape[0] = batch_size;
 	top[0]->reshape(topShape);
@@ -127,22 +161,44 @@ void DataLayer<Dtype>::dataLayerSetup(const vector<Blob<Dtype>*>& bottom, const
 	}
 }
 
+//	hand the prefetched storage to a top
+//	a top exposed outside(e.g. a numpy view) keeps its memory and gets a copy
+template <typename Dtype>
+static void handOut(Blob<Dtype>& storage, Blob<Dtype>* top){
+	if (!top->dataExposed()){
+		top->swapData(storage);
+		return;
+	}
+	if (Dragon::get_mode() == Dragon::CPU)
+		dragon_copy<Dtype>(storage.count(), top->mutable_cpu_data(), storage.cpu_data());
+#ifndef CPU_ONLY
+	else dragon_gpu_copy(storage.count(), top->mutable_gpu_data(), storage.gpu_data());
+#endif
+}
+
 template <typename Dtype>
 void DataLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
 	// consume
 	Batch<Dtype> *batch = full.pop("DataLayer prefectching queue is now empty");
-	dragon_copy<Dtype>(batch->data.count(), top[0]->mutable_cpu_data(), batch->data.cpu_data());
-	if (has_labels)
-		dragon_copy(batch->label.count(), top[1]->mutable_cpu_data(), batch->label.cpu_data());
+	//	hand out the prefetched storage instead of copying it
+	//	the old storage of tops is refilled in the batch
+	//	layers sharing the data of tops(e.g. ReshapeLayer) share it again in reshape()
+	//	and the holders of the old storage see a new version once it is refilled
+	handOut(batch->data, top[0]);
+	if (has_labels) handOut(batch->label, top[1]);
 	free.push(batch);
 }
 
 template <typename Dtype>
 void DataLayer<Dtype>::forward_gpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
 	Batch<Dtype> *batch = full.pop("DataLayer prefectching queue is now empty");
-	dragon_gpu_copy(batch->data.count(), top[0]->mutable_gpu_data(), batch->data.gpu_data());
-	if (has_labels)
-		dragon_gpu_copy(batch->label.count(), top[1]->mutable_gpu_data(), batch->label.gpu_data());
+	handOut(batch->data, top[0]);
+	if (has_labels) handOut(batch->label, top[1]);
+#ifndef CPU_ONLY
+	//	kernels of the last iteration may still read the old storage
+	//	and the prefetching thread refills it on its own non-blocking stream
+	CUDA_CHECK(cudaStreamSynchronize(0));
+#endif
 	free.push(batch);
 }
 
@@ -1,5 +1,6 @@
 ﻿#include "layers/common/softmax_layer.hpp"
 #include "layers/loss/softmax_loss_layer.hpp"
+#include "utils/thread_pool.hpp"
 
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
@@ -18,7 +19,7 @@ void SoftmaxWithLossLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom,
 	has_ignore_label = param.loss_param().has_ignore_label();
 	has_normalize = param.loss_param().has_normalize();
 	if (has_ignore_label) ignore_label = param.loss_param().ignore_label();
-	if (has_normalize) need_norm = param.loss_param().normalize();
+	need_norm = param.loss_param().normalize();
 }
 
 template <typename Dtype>
@@ -39,44 +40,85 @@ void SoftmaxWithLossLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, co
 		<< "Number of predictions must match the number of labels.";
 	//	original softmax prob output if need
 	if (top.size() >= 2) top[1]->reshapeLike(*bottom[0]);
+	log_sum.reshape(vector<int>(1, outer_num*inner_num));
 }
 
+//	fused log-softmax: loss_ij = log(sum_c(exp(x_c))) - x_label
+//	pass 1 takes the max of the classes, pass 2 sums exp(x-max) and picks the loss
+//	no prob is stored, backward gets it from the logits and log_sum in a single pass
+//	the spatial case(inner_num > 1) keeps a row of inner_num positions and walks the classes
+//	so the inner loops are contiguous and vectorize
 template <typename Dtype>
 void SoftmaxWithLossLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
-	// forward softmax to get prob
-	softmax_layer->forward(softmax_bottom, softmax_top);
-	const Dtype* prob_data = prob.cpu_data();
+	const Dtype* bottom_data = bottom[0]->cpu_data();
 	const Dtype* label_data = bottom[1]->cpu_data();
+	Dtype* log_sum_data = log_sum.mutable_cpu_data();
 	Dtype *top_data = top[0]->mutable_cpu_data();
-	int dim = prob.count() / outer_num;
-	int cnt = 0;
+	const int classes = bottom[0]->shape(axis);
+	const int dim = classes*inner_num;
+	//	-log(FLT_MIN), the bound of the old max(prob, FLT_MIN) clipping
+	const Dtype max_loss = -log(Dtype(FLT_MIN));
+	//	partial sums of each example, summed in order to stay independent of the threads
+	vector<Dtype> example_loss(outer_num, 0);
+	vector<int> example_cnt(outer_num, 0);
+	dragon_parallel_for(0, outer_num, dragon_parallel_grain(dim), [&](int lo, int hi){
+		vector<Dtype> sum(inner_num);
+		for (int i = lo; i < hi; i++){
+			const Dtype* x = bottom_data + i*dim;
+			Dtype* l = log_sum_data + i*inner_num;
+			if (inner_num == 1){
+				Dtype max_val = x[0];
+				for (int c = 1; c < classes; c++) max_val = max(max_val, x[c]);
+				Dtype s = 0;
+				for (int c = 0; c < classes; c++) s += exp(x[c] - max_val);
+				l[0] = max_val + log(s);
+			}
+			else{
+				for (int j = 0; j < inner_num; j++) l[j] = x[j];
+				for (int c = 1; c < classes; c++){
+					const Dtype* xc = x + c*inner_num;
+					for (int j = 0; j < inner_num; j++) l[j] = max(l[j], xc[j]);
+				}
+				for (int j = 0; j < inner_num; j++) sum[j] = 0;
+				for (int c = 0; c < classes; c++){
+					const Dtype* xc = x + c*inner_num;
+					for (int j = 0; j < inner_num; j++) sum[j] += exp(xc[j] - l[j]);
+				}
+				for (int j = 0; j < inner_num; j++) l[j] += log(sum[j]);
+			}
+			for (int j = 0; j < inner_num; j++){
+				const int label = label_data[i*inner_num + j];
+				if (has_ignore_label&&label == ignore_label) continue;
+				//	start from zero
+				CHECK_GE(label, 0);
+				//	max value must less than max classes
+				CHECK_LT(label, classes);
+				example_loss[i] += min(l[j] - x[label*inner_num + j], max_loss);
+				example_cnt[i]++;
+			}
+		}
+	});
 	Dtype loss = 0;
-	//	for each example
+	valid_count = 0;
 	for (int i = 0; i < outer_num; i++){
-		//	for each label in a example
-		for (int j = 0; j < inner_num; j++){
-			const int label = label_data[i*inner_num + j];
-			if (has_ignore_label&&label == ignore_label) continue;
-			//	start from zero
-			CHECK_GE(label, 0);
-			//	max value must less than max classes
-			CHECK_LT(label, prob.shape(axis));
-			//	we can regrad prob data as a 2D matrix for each example
-			//	MAT[classes,inner] and label*inner_num+j will get the j_th inner's label prob
-			Dtype labeled_prob = prob_data[i*dim + label*inner_num + j];
-			//	FLT_MIN=1.175494351e-38F
-			//	re-tune the output prob in case the numerical issue due to bug in log
-			//	log(0) is terrible but log(FLT_MIN) not
-			labeled_prob = max<Dtype>(labeled_prob, FLT_MIN);
-			//	sum up negative log loss
-			loss -= log(labeled_prob);
-			cnt++;
-		}
+		loss += example_loss[i];
+		valid_count += example_cnt[i];
 	}
 	//	average all labels 
-	if (need_norm) top_data[0] = loss / cnt;
+	if (need_norm) top_data[0] = loss / valid_count;
 	else top_data[0] = loss / outer_num;
-	if (top.size() == 2) top[1]->shareData(prob);
+	//	the prob is only computed if it is asked for
+	if (top.size() == 2){
+		Dtype* prob_data = prob.mutable_cpu_data();
+		dragon_parallel_for(0, outer_num, dragon_parallel_grain(dim), [&](int lo, int hi){
+			for (int i = lo; i < hi; i++)
+				for (int c = 0; c < classes; c++)
+					for (int j = 0; j < inner_num; j++)
+						prob_data[i*dim + c*inner_num + j] =
+							exp(bottom_data[i*dim + c*inner_num + j] - log_sum_data[i*inner_num + j]);
+		});
+		top[1]->shareData(prob);
+	}
 }
 
 template <typename Dtype>
@@ -85,34 +127,37 @@ void SoftmaxWithLossLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 	if (data_need_bp[1]) LOG(FATAL) << "Labels can not do back propogation.";
 	if (data_need_bp[0]){
 		Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-		const Dtype* prob_data = prob.cpu_data();
+		const Dtype* bottom_data = bottom[0]->cpu_data();
+		const Dtype* log_sum_data = log_sum.cpu_data();
 		const Dtype* label_data = bottom[1]->cpu_data();
+		const int classes = bottom[0]->shape(axis);
+		const int dim = classes*inner_num;
+		//	usually loss_weight equal to 1 and is setted in setLossWeight()
+		const Dtype loss_weight = top[0]->cpu_diff()[0];
+		//	loss/cnt => bottom_diff/cnt
+		const Dtype scale = need_norm ? loss_weight / valid_count : loss_weight / outer_num;
 		//	bottom_diff = prob_data-1 (class = label)
-		//				= prob_data-0 (class ¡Ù label)
+		//				= prob_data-0 (class != label)
 		//				= 0			  (ignore  label)
 		//	see also https://www.zhihu.com/question/28927103
-		dragon_copy<Dtype>(prob.count(), bottom_diff, prob_data);
-		int dim = prob.count() / outer_num;
-		int cnt = 0;
-		for (int i = 0; i < outer_num; i++){
-			for (int j = 0; j < inner_num; j++){
-				const int label = label_data[i*inner_num + j];
-				if (has_ignore_label&&label == ignore_label){
+		dragon_parallel_for(0, outer_num, dragon_parallel_grain(dim), [&](int lo, int hi){
+			for (int i = lo; i < hi; i++){
+				const Dtype* x = bottom_data + i*dim;
+				const Dtype* l = log_sum_data + i*inner_num;
+				Dtype* d = bottom_diff + i*dim;
+				for (int c = 0; c < classes; c++)
+					for (int j = 0; j < inner_num; j++)
+						d[c*inner_num + j] = exp(x[c*inner_num + j] - l[j])*scale;
+				for (int j = 0; j < inner_num; j++){
+					const int label = label_data[i*inner_num + j];
 					//	if we want to kill a label's gradient
 					//	we must clear for all classses(both [prob_data-1] and [prob_data])
-					for (int c = 0; c < bottom[0]->shape(axis); c++) bottom_diff[i*dim + c*inner_num + j] = 0;
-				}
-				else{
-					bottom_diff[i*dim + label*inner_num + j] -= 1;
-					cnt++;
+					if (has_ignore_label&&label == ignore_label)
+						for (int c = 0; c < classes; c++) d[c*inner_num + j] = 0;
+					else d[label*inner_num + j] -= scale;
 				}
 			}
-		}
-		//	usually loss_weight equal to 1 and is setted in setLossWeight()
-		const Dtype loss_weight = top[0]->cpu_diff()[0];
-		//	loss/cnt => bottom_diff/cnt
-		if (need_norm) dragon_scal<Dtype>(bottom[0]->count(), loss_weight / cnt, bottom_diff);
-		else dragon_scal<Dtype>(bottom[0]->count(), loss_weight / outer_num, bottom_diff);
+		});
 	}
 }
 
@@ -1,5 +1,6 @@
 #include "layers/common/softmax_layer.hpp"
 #include "layers/loss/softmax_loss_layer.hpp"
+#include "utils/workspace.hpp"
 
 template <typename Dtype>
 __global__ void ForwardKernel(const int n, const Dtype* prob_data, const Dtype* label_data,
@@ -26,12 +27,11 @@ void SoftmaxWithLossLayer<Dtype>::forward_gpu(const vector<Blob<Dtype>*> &bottom
 	const Dtype* label_data = bottom[1]->gpu_data();
 	const int classes = bottom[0]->shape(axis);
 	const int n = outer_num*inner_num;
-	//	used as a temporary blob to store loss before merging
-	//	only use the top outer_num*inner_num elements to merge
-	Dtype *loss_data = bottom[0]->mutable_gpu_diff();
-	//	used as a temporary blob to store the hit number
-	//	only use the top outer_num*inner_num elements to merge
-	Dtype *count_data = prob.mutable_gpu_diff();
+	//	use the workspace as the scratch instead of the bottom diff
+	//	so a net which never backwards need not allocate diffs for its bottoms
+	//	the first n elements store loss before merging, the next n store the hit number
+	Dtype *loss_data = (Dtype*)Workspace::Get().gpu(2 * n * sizeof(Dtype));
+	Dtype *count_data = loss_data + n;
 	Dtype loss = 0;
 	ForwardKernel<Dtype> << <GET_BLOCKS(n), CUDA_NUM_THREADS >> >(
 		n, prob_data, label_data, loss_data, classes, inner_num,
@@ -1,8 +1,12 @@
 #include "layers/neuron/dropout_layer.hpp"
+#include "utils/thread_pool.hpp"
 
 template <typename Dtype>
 void DropoutLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
 	prob = param.dropout_param().prob();
+	CHECK_GE(prob, 0);
+	CHECK_LT(prob, 1);
+	scale = Dtype(1) / (Dtype(1) - prob);
 	//	filter threshold(0~UINT_MAX*prob)
 	threshold = static_cast<unsigned int>(UINT_MAX*prob);
 }
@@ -10,8 +14,25 @@ void DropoutLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*>& bottom, const v
 template <typename Dtype>
 void DropoutLayer<Dtype>::reshape(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
 	NeuronLayer<Dtype>::reshape(bottom, top);
+	//	only the mask of the running device is allocated
 	vector<int> shape = bottom[0]->shape();
 	rand_vec.reshape(shape);
+	mask_bits.reshape(vector<int>(1, (bottom[0]->count() + 31) / 32));
+}
+
+//	y = x*bit*scale, a word of the mask covers 32 units
+template <typename Dtype>
+static void applyDropoutMask(const int count, const Dtype* x, const unsigned int* bits, const Dtype scale, Dtype* y){
+	const int num_words = (count + 31) / 32;
+	dragon_parallel_for(0, num_words, dragon_parallel_grain(32), [&](int lo, int hi){
+		for (int w = lo; w < hi; w++){
+			const unsigned int word = bits[w];
+			const int offset = w * 32;
+			const int len = min(32, count - offset);
+			for (int i = 0; i < len; i++)
+				y[offset + i] = (word >> i) & 1 ? x[offset + i] * scale : Dtype(0);
+		}
+	});
 }
 
 //	recommmend in-place method
@@ -19,17 +40,15 @@ template <typename Dtype>
 void DropoutLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
 	const Dtype* bottom_data = bottom[0]->cpu_data();
 	Dtype* top_data = top[0]->mutable_cpu_data();
-	unsigned int* mask = rand_vec.mutable_cpu_data();
 	const int count = bottom[0]->count();
 	if (phase == TRAIN){
-		dragon_rng_bernoulli<Dtype>(count, 1 - prob, mask);
-		for (int i = 0; i < count; i++)
-			top_data[i] = bottom_data[i] * mask[i];
+		unsigned int* bits = mask_bits.mutable_cpu_data();
+		dragon_rng_bernoulli_bits<Dtype>(count, 1 - prob, bits);
+		applyDropoutMask(count, bottom_data, bits, scale, top_data);
 	}
-	//	average net
-	//	(1-prob)*input=output
+	//	the expectation is kept by scaling in TRAIN
 	else if (phase == TEST)
-		dragon_cpu_axpby<Dtype>(count, Dtype(1) - prob, bottom_data, Dtype(0), top_data);
+		dragon_copy(count, top_data, bottom_data);
 }
 
 template <typename Dtype>
@@ -38,14 +57,10 @@ void DropoutLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 	if (data_need_bp[0]){
 		const Dtype* top_diff = top[0]->cpu_diff();
 		Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-		if (phase == TRAIN){
-			const unsigned int* mask = rand_vec.cpu_data();
-			for (int i = 0; i < bottom[0]->count(); i++)
-				bottom_diff[i] = top_diff[i] * mask[i];
-		}
-		else if (phase == TEST){
-			NOT_IMPLEMENTED;
-		}
+		if (phase == TRAIN)
+			applyDropoutMask(bottom[0]->count(), top_diff, mask_bits.cpu_data(), scale, bottom_diff);
+		else if (phase == TEST)
+			dragon_copy(bottom[0]->count(), bottom_diff, top_diff);
 	}
 }
 
@@ -2,10 +2,10 @@
 
 template<typename Dtype>
 __global__ void DropoutForwardKernel(const int n, const Dtype* bottom_data,
-	const unsigned int* mask, const unsigned int threshold, Dtype* top_data) {
+	const unsigned int* mask, const unsigned int threshold, const Dtype scale, Dtype* top_data) {
 	CUDA_KERNEL_LOOP(idx, n) {
 		//	filter the value lower threshold as zero
-		top_data[idx] = bottom_data[idx] * (mask[idx] > threshold);
+		top_data[idx] = bottom_data[idx] * (mask[idx] > threshold) * scale;
 	}
 }
 
@@ -21,21 +21,20 @@ void DropoutLayer<Dtype>::forward_gpu(const vector<Blob<Dtype>*>& bottom, const
 		//	then use threshold to filter them
 		dragon_gpu_rng_uniform(count, mask);
 		DropoutForwardKernel<Dtype> << <GET_BLOCKS(count), CUDA_NUM_THREADS >> >(
-			count, bottom_data, mask, threshold, top_data);
+			count, bottom_data, mask, threshold, scale, top_data);
 	}
+	//	inverted dropout, see also dropout_layer.cpp
 	else if (phase == TEST){
-		//	in-place 
-		if (bottom[0] == top[0]) dragon_gpu_scal<Dtype>(count, Dtype(1) - prob, top_data);
-		else dragon_gpu_axpby<Dtype>(count, Dtype(1) - prob, bottom_data, Dtype(0), top_data);
+		if (bottom[0] != top[0]) dragon_gpu_copy<Dtype>(count, top_data, bottom_data);
 	}
 	CUDA_POST_KERNEL_CHECK;
 }
 
 template <typename Dtype>
 __global__ void DropoutBackwardKernel(const int n, const Dtype* top_diff,
-	const unsigned int* mask, const unsigned int threshold, Dtype* bottom_diff) {
+	const unsigned int* mask, const unsigned int threshold, const Dtype scale, Dtype* bottom_diff) {
 	CUDA_KERNEL_LOOP(idx, n) {
-		bottom_diff[idx] = top_diff[idx] * (mask[idx] > threshold);
+		bottom_diff[idx] = top_diff[idx] * (mask[idx] > threshold) * scale;
 	}
 }
 
@@ -49,10 +48,10 @@ void DropoutLayer<Dtype>::backward_gpu(const vector<Blob<Dtype>*> &top,
 		if (phase == TRAIN){
 			const unsigned int* mask = rand_vec.gpu_data();
 			DropoutBackwardKernel<Dtype> << <GET_BLOCKS(count), CUDA_NUM_THREADS >> >(
-				count, top_diff, mask, threshold, bottom_diff);
+				count, top_diff, mask, threshold, scale, bottom_diff);
 		}
 		else if (phase == TEST){
-			NOT_IMPLEMENTED;
+			if (top[0] != bottom[0]) dragon_gpu_copy<Dtype>(count, bottom_diff, top_diff);
 		}
 	}
 	CUDA_POST_KERNEL_CHECK;
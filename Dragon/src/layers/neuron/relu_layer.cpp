@@ -1,4 +1,5 @@
 #include "layers/neuron/relu_layer.hpp"
+#include "utils/thread_pool.hpp"
 
 template <typename Dtype>
 void ReLULayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
@@ -6,9 +7,11 @@ void ReLULayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*>& bottom, const vec
 	Dtype* top_data = top[0]->mutable_cpu_data();
 	const int cnt = bottom[0]->count();
 	Dtype slope = param.relu_param().negative_slope();
-	for (int i = 0; i < cnt; i++)
-		top_data[i] = max<Dtype>(bottom_data[i], Dtype(0)) +
-		slope*min<Dtype>(bottom_data[i], Dtype(0));
+	dragon_parallel_for(0, cnt, dragon_parallel_grain(1), [&](int lo, int hi){
+		for (int i = lo; i < hi; i++)
+			top_data[i] = max<Dtype>(bottom_data[i], Dtype(0)) +
+			slope*min<Dtype>(bottom_data[i], Dtype(0));
+	});
 }
 
 template <typename Dtype>
@@ -22,8 +25,10 @@ void ReLULayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 		const int cnt = bottom[0]->count();
 		//	bottom_diff = top_diff*1
 		//				= slope
-		for (int i = 0; i < cnt; i++)
-			bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0) + slope*(bottom_data[i] <= 0));
+		dragon_parallel_for(0, cnt, dragon_parallel_grain(1), [&](int lo, int hi){
+			for (int i = lo; i < hi; i++)
+				bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0) + slope*(bottom_data[i] <= 0));
+		});
 	}
 }
 
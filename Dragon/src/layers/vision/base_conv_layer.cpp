@@ -4,6 +4,7 @@ template<typename Dtype>
 void BaseConvolutionLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
 	ConvolutionParameter conv_param = param.convolution_param();
 	force_nd_im2col = conv_param.force_nd_im2col();
+	im2col_batch_memory = conv_param.im2col_batch_memory();
 	// default axis=1, and channel_axis=1
 	channels_axis = bottom[0]->canonicalAxisIndex(conv_param.axis());
 	const int first_spatial_axis = channels_axis + 1;
@@ -125,10 +126,16 @@ void BaseConvolutionLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom,
 			bias_filler->fill(blobs[1].get());
 		}
 	}
+	//	depthwise convolution in mobile nets
+	is_depthwise = !reverseDimensions() && group > 1 && group == channels
+		&& num_spatial_axes == 2 && !force_nd_im2col;
 	//	channels_in/group * kernel_h * kernel_w
 	kernel_dim = blobs[0]->count(1);
 	//	channels_out*channels_in*kernel_h*kernel_w / group
 	weight_offset = conv_out_channels * kernel_dim / group;
+	//	set by the ReLU fusion of Net
+	fused_relu = param.has_fused_relu();
+	relu_slope = param.fused_relu().negative_slope();
 	// you can specfic weight/bias whether to participate back-propagation
 	param_need_bp.resize(blobs.size(), true);
 }
@@ -181,7 +188,22 @@ void BaseConvolutionLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, co
 		if (reverseDimensions()) col_buffer_shape.push_back(bottom_shape[channels_axis + i + 1]);
 		else col_buffer_shape.push_back(output_shape[i]);
 	}
-	col_buffer.reshape(col_buffer_shape);
+	col_buffer_count = 1;
+	for (int i = 0; i < col_buffer_shape.size(); i++) col_buffer_count *= col_buffer_shape[i];
+	//	each batched image needs its col and its output(before scattering back to NCHW)
+	//	deconv swaps the role of gemms, keep it unbatched
+	//	1x1 conv passes the input to the gemm without any copy, batching would add one
+	im2col_batch = 1;
+	if (!reverseDimensions() && !is_1x1 && !is_depthwise && im2col_batch_memory > 0 && num > 1){
+		const size_t image_bytes = (size_t)(kernel_dim*group + conv_out_channels)*conv_out_spatial_dim*sizeof(Dtype);
+		const size_t budget = (size_t)im2col_batch_memory << 20;
+		im2col_batch = (int)min((size_t)num, budget / image_bytes);
+		if (im2col_batch < 2) im2col_batch = 1;
+	}
+	//	1x1 conv uses the input as the col directly
+	if (im2col_batch > 1 && Dragon::get_mode() == Dragon::CPU)
+		Workspace::Get().reserve((size_t)(kernel_dim*group + conv_out_channels)*conv_out_spatial_dim*im2col_batch*sizeof(Dtype));
+	else if (!is_1x1 && !is_depthwise) Workspace::Get().reserve(col_buffer_count*sizeof(Dtype));
 	bottom_dim = bottom[0]->count(channels_axis);
 	top_dim = top[0]->count(channels_axis);
 	// 3D result (channel*blob_height*blob_width)
@@ -196,54 +218,78 @@ void BaseConvolutionLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, co
 	//	but not conv_out and conv_out_spatial_dim
 	if (bias_term){
 		//	1D
-		vector<int> bias_multiplier_shape(1, out_spatial_dim);
-		bias_multiplier.reshape(bias_multiplier_shape);
-		dragon_set(bias_multiplier.count(), Dtype(1.0), bias_multiplier.mutable_cpu_data());
+		//	optimization for set op
+		if (bias_multiplier.count() != out_spatial_dim){
+			vector<int> bias_multiplier_shape(1, out_spatial_dim);
+			bias_multiplier.reshape(bias_multiplier_shape);
+			dragon_set(bias_multiplier.count(), Dtype(1.0), bias_multiplier.mutable_cpu_data());
+		}
 	}
+	//	one byte per output of every top
+	const size_t mask_size = (size_t)top.size()*num*top_dim;
+	if (fused_relu && phase == TRAIN){
+		if (!relu_mask || relu_mask->size() < mask_size) relu_mask.reset(new SyncedMemory(mask_size));
+	}
+	else relu_mask.reset();
 }
 
 template<typename Dtype>
-void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output, bool skip_im2col){
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output, bool skip_im2col,
+	Dtype* col){
+	if (is_depthwise){
+		depthwise_conv_cpu(input, channels, conv_input_shape.cpu_data()[1], conv_input_shape.cpu_data()[2],
+			conv_out_channels / group, kernel_shape.cpu_data()[0], kernel_shape.cpu_data()[1],
+			pad.cpu_data()[0], pad.cpu_data()[1], stride.cpu_data()[0], stride.cpu_data()[1], weights, output);
+		return;
+	}
 	const Dtype* col_buff_ = input;
 	//	1x1 is a special case, im2col do nothing so we needn't do it to waste time
 	if (!is_1x1){
-		if (!skip_im2col) conv_im2col_cpu(input, col_buffer.mutable_cpu_data());
+		Dtype* col_buffer = col ? col : col_buffer_cpu();
+		if (!skip_im2col) conv_im2col_cpu(input, col_buffer);
 		// after patch just use const data
-		col_buff_ = col_buffer.cpu_data();
-	}
-	for (int g = 0; g < group; g++){
-		//	MAT[out_channels,kernel_dim] x MAT[kernel_dim,conv_out_spatial_dim]
-		//	=MAT[out_channels,conv_out_spatial_dim]
-		//	kernel_dim using input_channels/group in Matrix-Product
-		//	so each output Mat has the sum of subset channles directly
-		//	weight_off and output_off decide the output map in different groups
-		//	col_off decide the input map in differnet groups
-		//	group convolution is the method in LeNet5 or early convnet
-		//	actually it is almost useless but also implemented in Caffe Framework
-		//	refer to https://www.zhihu.com/question/26871787/answer/38935261 @Yangqing Jia
-		dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels / group,
-			conv_out_spatial_dim, kernel_dim, (Dtype)1.0, weights + weight_offset*g, col_buff_ + col_offset*g,
-			(Dtype)0.0, output + output_offset*g);
+		col_buff_ = col_buffer;
 	}
+	//	MAT[out_channels,kernel_dim] x MAT[kernel_dim,conv_out_spatial_dim]
+	//	=MAT[out_channels,conv_out_spatial_dim]
+	//	kernel_dim using input_channels/group in Matrix-Product
+	//	so each output Mat has the sum of subset channles directly
+	//	weight_off and output_off decide the output map in different groups
+	//	col_off decide the input map in differnet groups
+	//	group convolution is the method in LeNet5 or early convnet
+	//	actually it is almost useless but also implemented in Caffe Framework
+	//	refer to https://www.zhihu.com/question/26871787/answer/38935261 @Yangqing Jia
+	dragon_cpu_gemm_strided_batched<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels / group,
+		conv_out_spatial_dim, kernel_dim, (Dtype)1.0, weights, weight_offset, col_buff_, col_offset,
+		(Dtype)0.0, output, output_offset, group);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_epilogue(Dtype* output, const Dtype* bias, unsigned char* mask){
+	//	a pass over the image just produced by the gemm
+	//	instead of a rank-1 gemm against bias_multiplier and another pass for ReLU
+	if (!bias && !fused_relu) return;
+	bias_relu_cpu(num_output, out_spatial_dim, output, out_spatial_dim, bias, fused_relu, relu_slope, output, mask);
 }
 
 template <typename Dtype>
-void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output, const Dtype* bias){
-	//	bias_vector[num_out,1] x mul[1,out_spatial_dim]=bias[num_out,out_spatial_dim]
-	//	bias_multiplier see also at the end of reshape()
-	//	from this gemm op we get a bias matrix
-	//	then we could do mat_weight + mat_bias use the param_beta in cpu_gemm
-	//	final_out=alpha*bias_vec*bias_mul+beta*weight_out (alpha=beta=1.0)
-	//	final_out matrix should be splitted into a 3D(channels,height,width) form then
-	dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output, out_spatial_dim, 1, (Dtype)1.0,
-		bias, bias_multiplier.cpu_data(), (Dtype)1.0, output);
+const Dtype* BaseConvolutionLayer<Dtype>::backward_cpu_epilogue(const int top_id, Blob<Dtype>* top){
+	if (!fused_relu) return top->cpu_diff();
+	Dtype* top_diff = top->mutable_cpu_diff();
+	relu_backward_cpu(top->count(), relu_mask ? reluMask(top_id, 0) : NULL, top->cpu_data(), relu_slope, top_diff);
+	return top_diff;
 }
 
 template<typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output, const Dtype* weights, Dtype* input){
-	Dtype* col_buff_ = col_buffer.mutable_cpu_data();
+	if (is_depthwise){
+		depthwise_conv_backward_data_cpu(output, channels, conv_input_shape.cpu_data()[1], conv_input_shape.cpu_data()[2],
+			conv_out_channels / group, kernel_shape.cpu_data()[0], kernel_shape.cpu_data()[1],
+			pad.cpu_data()[0], pad.cpu_data()[1], stride.cpu_data()[0], stride.cpu_data()[1], weights, input);
+		return;
+	}
 	// we do not copy the data into col_buff at the condition of 1x1
-	if (is_1x1) col_buff_ = input;
+	Dtype* col_buff_ = is_1x1 ? input : col_buffer_cpu();
 	//	MAT[kernel_dim,out_channels] x MAT[out_channels,conv_out_spatial_dim]
 	//	=MAT[kernel_dim,conv_out_spatial_dim]
 	//	it is a inverse op comparing to forward_cpu_gemm()
@@ -251,10 +297,9 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output, const D
 	//	we use weight and output to get col
 	//	transpose op in blas must specific lda/ldb/ldc explicitly using CblasTrans flag in gemm op
 	//	more see dragon_cpu_gemm() in math_functions.cpp
-	for (int g = 0; g < group; g++){
-		dragon_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim, conv_out_spatial_dim, conv_out_channels / group,
-			(Dtype)1.0, weights + weight_offset*g, output + output_offset*g, (Dtype)0.0, col_buff_ + col_offset*g);
-	}
+	dragon_cpu_gemm_strided_batched<Dtype>(CblasTrans, CblasNoTrans, kernel_dim, conv_out_spatial_dim,
+		conv_out_channels / group, (Dtype)1.0, weights, weight_offset, output, output_offset,
+		(Dtype)0.0, col_buff_, col_offset, group);
 	//	1x1 also do nothing
 	if (!is_1x1){
 		conv_col2im_cpu(col_buff_, input);
@@ -262,17 +307,75 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output, const D
 }
 
 template<typename Dtype>
-void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype *weights){
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype *weights, const Dtype* col){
+	if (is_depthwise){
+		depthwise_conv_backward_weights_cpu(input, output, channels, conv_input_shape.cpu_data()[1],
+			conv_input_shape.cpu_data()[2], conv_out_channels / group, kernel_shape.cpu_data()[0],
+			kernel_shape.cpu_data()[1], pad.cpu_data()[0], pad.cpu_data()[1], stride.cpu_data()[0],
+			stride.cpu_data()[1], weights);
+		return;
+	}
 	const Dtype *col_buff_ = input;
 	//	patch the input as col_buff before
-	if (!is_1x1){
-		conv_im2col_cpu(input, col_buffer.mutable_cpu_data());
-		col_buff_ = col_buffer.cpu_data();
+	if (col) col_buff_ = col;
+	else if (!is_1x1){
+		Dtype* col_buffer = col_buffer_cpu();
+		conv_im2col_cpu(input, col_buffer);
+		col_buff_ = col_buffer;
 	}
-	for (int g = 0; g < group; g++){
-		dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels / group,
-			kernel_dim, conv_out_spatial_dim, (Dtype)1.0, output + output_offset*g,
-			col_buff_ + col_offset*g, (Dtype)1.0, weights + weight_offset*g);
+	dragon_cpu_gemm_strided_batched<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels / group,
+		kernel_dim, conv_out_spatial_dim, (Dtype)1.0, output, output_offset,
+		col_buff_, col_offset, (Dtype)1.0, weights, weight_offset, group);
+}
+
+template<typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batched(const Dtype* input, const Dtype* weights, const Dtype* bias,
+	Dtype* output, unsigned char* mask, const int batch_size, Dtype* col){
+	//	col: MAT[kernel_dim*group, ld], out: MAT[conv_out_channels, ld]
+	//	the k_th image takes the columns [k*conv_out_spatial_dim, (k+1)*conv_out_spatial_dim)
+	const int ld = batch_size*conv_out_spatial_dim;
+	Dtype* workspace = (Dtype*)Workspace::Get().cpu((size_t)(kernel_dim*group + conv_out_channels)*ld*sizeof(Dtype));
+	Dtype* col_buff_ = col ? col : workspace;
+	Dtype* out_buff_ = workspace + kernel_dim*group*ld;
+	for (int k = 0; k < batch_size; k++)
+		conv_im2col_cpu(input + k*bottom_dim, col_buff_ + k*conv_out_spatial_dim, ld);
+	dragon_cpu_gemm_strided_batched<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels / group,
+		ld, kernel_dim, (Dtype)1.0, weights, weight_offset, col_buff_, kernel_dim*ld,
+		(Dtype)0.0, out_buff_, output_offset*batch_size, group);
+	//	scatter back to NCHW and run the epilogue on the way
+	for (int k = 0; k < batch_size; k++)
+		bias_relu_cpu(conv_out_channels, conv_out_spatial_dim, out_buff_ + k*conv_out_spatial_dim, ld,
+			bias, fused_relu, relu_slope, output + k*top_dim, mask ? mask + k*top_dim : NULL);
+}
+
+template<typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_gemm_batched(const Dtype* input, const Dtype* output_diff,
+	const Dtype* weights, Dtype* weights_diff, Dtype* input_diff, const int batch_size, const Dtype* col){
+	const int ld = batch_size*conv_out_spatial_dim;
+	Dtype* col_buff_ = (Dtype*)Workspace::Get().cpu((size_t)(kernel_dim*group + conv_out_channels)*ld*sizeof(Dtype));
+	Dtype* out_buff_ = col_buff_ + kernel_dim*group*ld;
+	//	gather the output diff of batch_size images side by side
+	for (int k = 0; k < batch_size; k++)
+		for (int c = 0; c < conv_out_channels; c++)
+			dragon_copy(conv_out_spatial_dim, out_buff_ + c*ld + k*conv_out_spatial_dim,
+				output_diff + k*top_dim + c*conv_out_spatial_dim);
+	if (weights_diff){
+		//	weight_diff += delta_(layer+1)*col^T, summed over the batch by the gemm
+		if (!col){
+			for (int k = 0; k < batch_size; k++)
+				conv_im2col_cpu(input + k*bottom_dim, col_buff_ + k*conv_out_spatial_dim, ld);
+		}
+		dragon_cpu_gemm_strided_batched<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels / group,
+			kernel_dim, ld, (Dtype)1.0, out_buff_, output_offset*batch_size,
+			col ? col : col_buff_, kernel_dim*ld, (Dtype)1.0, weights_diff, weight_offset, group);
+	}
+	if (input_diff){
+		//	col = weights^T*delta_(layer+1), then fold every image back
+		dragon_cpu_gemm_strided_batched<Dtype>(CblasTrans, CblasNoTrans, kernel_dim, ld,
+			conv_out_channels / group, (Dtype)1.0, weights, weight_offset, out_buff_, output_offset*batch_size,
+			(Dtype)0.0, col_buff_, kernel_dim*ld, group);
+		for (int k = 0; k < batch_size; k++)
+			conv_col2im_cpu(col_buff_ + k*conv_out_spatial_dim, input_diff + k*bottom_dim, ld);
 	}
 }
 
@@ -288,8 +391,9 @@ template<typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output, bool skip_im2col){
 	const Dtype* col_buff_ = input;
 	if (!is_1x1){
-		if (!skip_im2col) conv_im2col_gpu(input, col_buffer.mutable_gpu_data());
-		col_buff_ = col_buffer.gpu_data();
+		Dtype* col_buffer = col_buffer_gpu();
+		if (!skip_im2col) conv_im2col_gpu(input, col_buffer);
+		col_buff_ = col_buffer;
 	}
 	for (int g = 0; g < group; g++){
 		dragon_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels / group,
@@ -305,8 +409,7 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output, const Dtype* b
 }
 template<typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output, const Dtype* weights, Dtype* input){
-	Dtype* col_buff_ = col_buffer.mutable_gpu_data();
-	if (is_1x1) col_buff_ = input;
+	Dtype* col_buff_ = is_1x1 ? input : col_buffer_gpu();
 	for (int g = 0; g < group; g++){
 		dragon_gpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim, conv_out_spatial_dim, conv_out_channels / group,
 			(Dtype)1.0, weights + weight_offset*g, output + output_offset*g, (Dtype)0.0, col_buff_ + col_offset*g);
@@ -318,8 +421,9 @@ template<typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_gpu_gemm(const Dtype* input, const Dtype* output, Dtype *weights){
 	const Dtype *col_buff_ = input;
 	if (!is_1x1){
-		conv_im2col_gpu(input, col_buffer.mutable_gpu_data());
-		col_buff_ = col_buffer.gpu_data();
+		Dtype* col_buffer = col_buffer_gpu();
+		conv_im2col_gpu(input, col_buffer);
+		col_buff_ = col_buffer;
 	}
 	for (int g = 0; g < group; g++){
 		dragon_gpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels / group,
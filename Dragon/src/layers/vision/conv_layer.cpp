@@ -28,6 +28,90 @@ void DeconvolutionLayer<Dtype>::computeOutputShape(){
 	}
 }
 
+template<typename Dtype>
+void ConvolutionLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
+	BaseConvolutionLayer<Dtype>::layerSetup(bottom, top);
+	use_winograd = false;
+	winograd_m = 0;
+	if (param.convolution_param().engine() != ConvolutionParameter_Engine_WINOGRAD) return;
+	const int* kernel_data = kernel_shape.cpu_data();
+	const int* stride_data = stride.cpu_data();
+	const int* pad_data = pad.cpu_data();
+	//	the data gradient is a convolution with pad 2-pad
+	use_winograd = num_spatial_axes == 2 && group == 1 && !force_nd_im2col;
+	for (int i = 0; use_winograd && i < num_spatial_axes; i++)
+		use_winograd = kernel_data[i] == 3 && stride_data[i] == 1 && pad_data[i] <= 2;
+	if (!use_winograd)
+		LOG(INFO) << "Layer " << param.name() << " can not use WINOGRAD engine, fall back to im2col";
+}
+
+template<typename Dtype>
+void ConvolutionLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
+	BaseConvolutionLayer<Dtype>::reshape(bottom, top);
+	//	im2col is skipped by 1x1/depthwise/winograd, nothing to retain
+	retained_images = 0;
+	const size_t retain_budget = (size_t)param.convolution_param().retain_columns_memory() << 20;
+	if (retain_budget > 0 && phase == TRAIN && !is_1x1 && !is_depthwise && !use_winograd){
+		retained_images = (int)min((size_t)num, retain_budget / (col_buffer_count*sizeof(Dtype)*bottom.size()));
+		vector<int> shape(2);
+		shape[0] = bottom.size();
+		shape[1] = retained_images*col_buffer_count;
+		retained_columns.reshape(shape);
+		retained_src.resize(bottom.size());
+		retained_version.resize(bottom.size());
+	}
+	if (!use_winograd) return;
+	const int in_height = conv_input_shape.cpu_data()[1], in_width = conv_input_shape.cpu_data()[2];
+	//	F(4x4,3x3) has less multiplications but wastes more on the border tiles of small maps
+	const int m = min(output_shape[0], output_shape[1]) >= 8 ? 4 : 2;
+	//	the cached weights depend on the tile size
+	if (m != winograd_m){
+		winograd_src[0].reset();
+		winograd_src[1].reset();
+		winograd_m = m;
+	}
+	//	the transformed tiles of several images go through the same gemms
+	const size_t image_bytes = max(
+		winograd_workspace_count(1, channels, num_output, output_shape[0], output_shape[1], winograd_m),
+		winograd_workspace_count(1, num_output, channels, in_height, in_width, winograd_m))*sizeof(Dtype);
+	const size_t budget = (size_t)max(im2col_batch_memory, 1) << 20;
+	winograd_batch = (int)max((size_t)1, min((size_t)num, budget / image_bytes));
+	if (Dragon::get_mode() == Dragon::CPU) Workspace::Get().reserve(image_bytes*winograd_batch);
+}
+
+template<typename Dtype>
+const Dtype* ConvolutionLayer<Dtype>::winogradWeights(const bool flip){
+	const boost::shared_ptr<SyncedMemory>& src = blobs[0]->data();
+	Blob<Dtype>& transformed = winograd_weights[flip];
+	//	transform once per weight update
+	if (winograd_src[flip] != src || winograd_version[flip] != src->version()){
+		vector<int> shape(3);
+		shape[0] = (winograd_m + 2)*(winograd_m + 2);
+		shape[1] = flip ? channels : num_output;
+		shape[2] = flip ? num_output : channels;
+		transformed.reshape(shape);
+		winograd_transform_weights(blobs[0]->cpu_data(), num_output, channels, winograd_m, flip,
+			transformed.mutable_cpu_data());
+		winograd_src[flip] = src;
+		winograd_version[flip] = src->version();
+	}
+	return transformed.cpu_data();
+}
+
+template<typename Dtype>
+void ConvolutionLayer<Dtype>::winograd_cpu(const Dtype* input, const Dtype* transformed, const int in_channels,
+	const int in_height, const int in_width, const int pad_h, const int pad_w, const int out_channels, Dtype* output){
+	const int out_height = in_height + 2 * pad_h - 2, out_width = in_width + 2 * pad_w - 2;
+	const int in_dim = in_channels*in_height*in_width, out_dim = out_channels*out_height*out_width;
+	for (int n = 0; n < num; n += winograd_batch){
+		const int batch_size = min(winograd_batch, num - n);
+		Dtype* workspace = (Dtype*)Workspace::Get().cpu(winograd_workspace_count(batch_size, in_channels,
+			out_channels, out_height, out_width, winograd_m)*sizeof(Dtype));
+		winograd_conv_cpu(input + n*in_dim, batch_size, in_channels, in_height, in_width, pad_h, pad_w,
+			transformed, out_channels, winograd_m, output + n*out_dim, workspace);
+	}
+}
+
 template<typename Dtype>
 void ConvolutionLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
 	//	4D(out_channels,in_channels,kernel_h,kernel_w)
@@ -39,15 +123,38 @@ void ConvolutionLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom, co
 		//	call reshape() to set a top blob referring to a bottom blob
 		//	so top/bottom has the same blob quantity
 		Dtype *top_data = top[i]->mutable_cpu_data();
+		if (winograd_m){
+			winograd_cpu(bottom_data, winogradWeights(false), channels,
+				conv_input_shape.cpu_data()[1], conv_input_shape.cpu_data()[2],
+				pad.cpu_data()[0], pad.cpu_data()[1], num_output, top_data);
+			const Dtype* bias = bias_term ? blobs[1]->cpu_data() : NULL;
+			for (int n = 0; n < num; n++) forward_cpu_epilogue(top_data + n*top_dim, bias, reluMask(i, n));
+			continue;
+		}
+		//	keep the columns for the weight gradient
+		const bool retain = retained_images > 0 && param_need_bp[0];
+		if (retained_images > 0){
+			retained_src[i] = retain ? bottom[i]->data() : boost::shared_ptr<SyncedMemory>();
+			retained_version[i] = bottom[i]->data()->version();
+		}
+		//	patch several images together for the larger gemm
+		if (im2col_batch > 1){
+			const Dtype* bias = bias_term ? blobs[1]->cpu_data() : NULL;
+			for (int n = 0; n < num; n += im2col_batch){
+				const int batch_size = min(im2col_batch, num - n);
+				forward_cpu_gemm_batched(bottom_data + n*bottom_dim, weights, bias, top_data + n*top_dim,
+					reluMask(i, n), batch_size, retain ? retainedColumns(i, n, batch_size) : NULL);
+			}
+			continue;
+		}
 		//	scan a batch
+		const Dtype* bias = bias_term ? blobs[1]->cpu_data() : NULL;
 		for (int n = 0; n < num; n++){
 			//	Wx
-			forward_cpu_gemm(bottom_data + n*bottom_dim, weights, top_data + n*top_dim);
-			if (bias_term){
-				const Dtype* bias = blobs[1]->cpu_data();
-				//	Wx+b
-				forward_cpu_bias(top_data + n*top_dim, bias);
-			}
+			forward_cpu_gemm(bottom_data + n*bottom_dim, weights, top_data + n*top_dim, false,
+				retain ? retainedColumns(i, n, 1) : NULL);
+			//	act(Wx+b) while the image is still in the cache
+			forward_cpu_epilogue(top_data + n*top_dim, bias, reluMask(i, n));
 		}
 	}
 }
@@ -60,10 +167,7 @@ void DeconvolutionLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom,
 		Dtype *top_data = top[i]->mutable_cpu_data();
 		for (int n = 0; n < num; n++){
 			backward_cpu_gemm(bottom_data + n*bottom_dim, weights, top_data + n*top_dim);
-			if (bias_term){
-				const Dtype* bias = blobs[1]->cpu_data();
-				forward_cpu_bias(top_data + n*top_dim, bias);
-			}
+			forward_cpu_epilogue(top_data + n*top_dim, bias_term ? blobs[1]->cpu_data() : NULL, reluMask(i, n));
 		}
 	}
 }
@@ -72,15 +176,18 @@ template<typename Dtype>
 void ConvolutionLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 	const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom){
 	const Dtype* weights = blobs[0]->cpu_data();
-	//syncedmem only allocate diff memory after we call mutable_cpu_diff()
-	Dtype *weight_diff = blobs[0]->mutable_cpu_diff();
+	//	diffs are allocated lazily, only fetch the ones we will write
+	Dtype *weight_diff = param_need_bp[0] ? blobs[0]->mutable_cpu_diff() : NULL;
 	//	multi-output
 	//	we define sub-gradient as delta
 	//	delta_(layer+1)=top->diff
 	for (int i = 0; i < top.size(); i++){
-		const Dtype* top_diff = top[i]->cpu_diff();
+		const Dtype* top_diff = backward_cpu_epilogue(i, top[i]);
 		const Dtype* bottom_data = bottom[i]->cpu_data();
-		Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+		Dtype* bottom_diff = data_need_bp[i] ? bottom[i]->mutable_cpu_diff() : NULL;
+		//	columns from forward are valid if the bottom data was not written since then
+		const bool retained = retained_images > 0 && retained_src[i] == bottom[i]->data()
+			&& retained_version[i] == bottom[i]->data()->version();
 		if (bias_term && param_need_bp[1]){
 			//cout << "CONV BACKWARD BIAS" << endl;
 			Dtype *bias_diff = blobs[1]->mutable_cpu_diff();
@@ -91,7 +198,29 @@ void ConvolutionLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 			for (int n = 0; n < num; n++)
 				backward_cpu_bias(bias_diff, top_diff + n*top_dim);
 		}
-		if (param_need_bp[0] || data_need_bp[i]){
+		if (winograd_m && data_need_bp[i]){
+			//	the data gradient is a convolution of top_diff with the rotated weights
+			//	the weight gradient still uses im2col
+			if (param_need_bp[0]){
+				for (int n = 0; n < num; n += im2col_batch){
+					if (im2col_batch > 1)
+						backward_cpu_gemm_batched(bottom_data + n*bottom_dim, top_diff + n*top_dim, weights,
+							weight_diff, NULL, min(im2col_batch, num - n));
+					else weight_cpu_gemm(bottom_data + n*bottom_dim, top_diff + n*top_dim, weight_diff);
+				}
+			}
+			winograd_cpu(top_diff, winogradWeights(true), num_output, output_shape[0], output_shape[1],
+				2 - pad.cpu_data()[0], 2 - pad.cpu_data()[1], channels, bottom_diff);
+		}
+		else if ((param_need_bp[0] || data_need_bp[i]) && im2col_batch > 1){
+			for (int n = 0; n < num; n += im2col_batch){
+				const int batch_size = min(im2col_batch, num - n);
+				backward_cpu_gemm_batched(bottom_data + n*bottom_dim, top_diff + n*top_dim, weights,
+					weight_diff, data_need_bp[i] ? bottom_diff + n*bottom_dim : NULL, batch_size,
+					retained ? retainedColumns(i, n, batch_size) : NULL);
+			}
+		}
+		else if (param_need_bp[0] || data_need_bp[i]){
 			//if (param_need_bp[0]) cout << "CONV BACKWARD WEIGHT" << endl;
 			//if (data_need_bp[i]) cout << "CONV BACKWARD BOTTOM" << endl;
 			for (int n = 0; n < num; n++){
@@ -101,7 +230,8 @@ void ConvolutionLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 				//	so in conv_layer, we replace input with col(patched input)
 				//	also we need sum up delta for all units in a batch
 				if (param_need_bp[0])
-					weight_cpu_gemm(bottom_data + n*bottom_dim, top_diff + n*top_dim, weight_diff);
+					weight_cpu_gemm(bottom_data + n*bottom_dim, top_diff + n*top_dim, weight_diff,
+						retained ? retainedColumns(i, n, 1) : NULL);
 				if (data_need_bp[i])
 					//	bottom_diff += delta_(layer+1)*weights
 					//	bottom_diff actually is delta_(layer) and will be used in prev layer
@@ -118,11 +248,11 @@ template<typename Dtype>
 void DeconvolutionLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 	const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom){
 	const Dtype* weights = blobs[0]->cpu_data();
-	Dtype *weight_diff = blobs[0]->mutable_cpu_diff();
+	Dtype *weight_diff = param_need_bp[0] ? blobs[0]->mutable_cpu_diff() : NULL;
 	for (int i = 0; i < top.size(); i++){
-		const Dtype* top_diff = top[i]->cpu_diff();
+		const Dtype* top_diff = backward_cpu_epilogue(i, top[i]);
 		const Dtype* bottom_data = bottom[i]->cpu_data();
-		Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+		Dtype* bottom_diff = data_need_bp[i] ? bottom[i]->mutable_cpu_diff() : NULL;
 		if (bias_term && param_need_bp[1]){
 			Dtype *bias_diff = blobs[1]->mutable_cpu_diff();
 			for (int n = 0; n < num; n++)
@@ -2,6 +2,7 @@
 
 template<typename Dtype>
 void ConvolutionLayer<Dtype>::forward_gpu(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
+	CHECK(!fused_relu) << "The fused ReLU is only implemented on CPU, build the net with fuse_relu off to use GPU mode.";
 	//	4D(out_channels,in_channels,kernel_h,kernel_w)
 	const Dtype* weights = blobs[0]->gpu_data();
 	//	multi-input
@@ -44,14 +45,14 @@ template<typename Dtype>
 void ConvolutionLayer<Dtype>::backward_gpu(const vector<Blob<Dtype>*> &top,
 	const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom){
 	const Dtype* weights = blobs[0]->gpu_data();
-	Dtype *weight_diff = blobs[0]->mutable_gpu_diff();
+	Dtype *weight_diff = param_need_bp[0] ? blobs[0]->mutable_gpu_diff() : NULL;
 	//	multi-output
 	//	we define sub-gradient as delta
 	//	delta_(layer+1)=top->diff
 	for (int i = 0; i < top.size(); i++){
 		const Dtype* top_diff = top[i]->gpu_diff();
 		const Dtype* bottom_data = bottom[i]->gpu_data();
-		Dtype* bottom_diff = bottom[i]->mutable_gpu_diff();
+		Dtype* bottom_diff = data_need_bp[i] ? bottom[i]->mutable_gpu_diff() : NULL;
 		if (bias_term && param_need_bp[1]){
 			Dtype *bias_diff = blobs[1]->mutable_gpu_diff();
 			//	bias_diff += delta_(layer+1)
@@ -86,11 +87,11 @@ template<typename Dtype>
 void DeconvolutionLayer<Dtype>::backward_gpu(const vector<Blob<Dtype>*> &top,
 	const vector<bool> &data_need_bp, const vector<Blob<Dtype>*> &bottom){
 	const Dtype* weights = blobs[0]->gpu_data();
-	Dtype *weight_diff = blobs[0]->mutable_gpu_diff();
+	Dtype *weight_diff = param_need_bp[0] ? blobs[0]->mutable_gpu_diff() : NULL;
 	for (int i = 0; i < top.size(); i++){
 		const Dtype* top_diff = top[i]->gpu_diff();
 		const Dtype* bottom_data = bottom[i]->gpu_data();
-		Dtype* bottom_diff = bottom[i]->mutable_gpu_diff();
+		Dtype* bottom_diff = data_need_bp[i] ? bottom[i]->mutable_gpu_diff() : NULL;
 		if (bias_term && param_need_bp[1]){
 			Dtype *bias_diff = blobs[1]->mutable_gpu_diff();
 			for (int n = 0; n < num; n++)
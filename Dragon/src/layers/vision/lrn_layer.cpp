@@ -1,4 +1,48 @@
 #include "layers/vision/lrn_layer.hpp"
+#include "utils/thread_pool.hpp"
+
+//	columns of a plane processed together in ACROSS_CHANNELS
+//	the running sums of a tile stay in the cache while walking the channels
+static const int LRN_TILE = 512;
+
+//	out = in * scale^(-beta), 0.75 is the usual beta and needs no pow()
+template <typename Dtype>
+static void lrnApply(const int n, const Dtype* in, const Dtype* scale, const Dtype beta, Dtype* out){
+	if (beta == Dtype(0.75))
+		for (int i = 0; i < n; i++) out[i] = in[i] / sqrt(scale[i] * sqrt(scale[i]));
+	else
+		for (int i = 0; i < n; i++) out[i] = in[i] * pow(scale[i], -beta);
+}
+
+//	sum over the size x size window centered at each pixel, zeros outside
+//	separable: running sums along the rows into tmp, then along the columns
+//	out may be the same as in
+template <typename Dtype>
+static void lrnBoxSum(const Dtype* in, const int height, const int width, const int pre_pad, const int post_pad,
+	Dtype* tmp, Dtype* out){
+	for (int h = 0; h < height; h++){
+		const Dtype* src = in + h*width;
+		Dtype* dst = tmp + h*width;
+		Dtype accum = 0;
+		for (int w = 0; w < post_pad && w < width; w++) accum += src[w];
+		for (int w = 0; w < width; w++){
+			if (w + post_pad < width) accum += src[w + post_pad];
+			if (w - pre_pad - 1 >= 0) accum -= src[w - pre_pad - 1];
+			dst[w] = accum;
+		}
+	}
+	//	whole rows at a time so the inner loop runs along the width
+	vector<Dtype> row(width, Dtype(0));
+	for (int h = 0; h < post_pad && h < height; h++)
+		for (int w = 0; w < width; w++) row[w] += tmp[h*width + w];
+	for (int h = 0; h < height; h++){
+		if (h + post_pad < height)
+			for (int w = 0; w < width; w++) row[w] += tmp[(h + post_pad)*width + w];
+		if (h - pre_pad - 1 >= 0)
+			for (int w = 0; w < width; w++) row[w] -= tmp[(h - pre_pad - 1)*width + w];
+		dragon_copy(width, out + h*width, &row[0]);
+	}
+}
 
 template <typename Dtype>
 void LRNLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -9,6 +53,7 @@ void LRNLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*>& bottom, const vecto
 	alpha_ = lrn_param.alpha();
 	beta_ = lrn_param.beta();
 	k_ = lrn_param.k();
+	//	the chain is only run on GPU, its blobs get memory at the first GPU forward
 	if (lrn_param.norm_region() == LRNParameter_NormRegion_WITHIN_CHANNEL) {
 		// Set up split_layer_ to use inputs in the numerator and denominator.
 		split_top_vec_.clear();
@@ -71,18 +116,14 @@ void LRNLayer<Dtype>::reshape(const vector<Blob<Dtype>*>& bottom,
 	channels_ = bottom[0]->channels();
 	height_ = bottom[0]->height();
 	width_ = bottom[0]->width();
-	switch (param.lrn_param().norm_region()) {
-	case LRNParameter_NormRegion_ACROSS_CHANNELS:
-		top[0]->reshape(num_, channels_, height_, width_);
-		scale_.reshape(num_, channels_, height_, width_);
-		break;
-	case LRNParameter_NormRegion_WITHIN_CHANNEL:
+	top[0]->reshape(num_, channels_, height_, width_);
+	scale_.reshape(num_, channels_, height_, width_);
+	if (param.lrn_param().norm_region() == LRNParameter_NormRegion_WITHIN_CHANNEL) {
 		split_layer_->reshape(bottom, split_top_vec_);
 		square_layer_->reshape(square_bottom_vec_, square_top_vec_);
 		pool_layer_->reshape(square_top_vec_, pool_top_vec_);
 		power_layer_->reshape(pool_top_vec_, power_top_vec_);
 		product_layer_->reshape(product_bottom_vec_, top);
-		break;
 	}
 }
 
@@ -91,9 +132,10 @@ void LRNLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*>& bottom,
 	const vector<Blob<Dtype>*>& top) {
 	switch (param.lrn_param().norm_region()) {
 	case LRNParameter_NormRegion_ACROSS_CHANNELS:
-		NOT_IMPLEMENTED;
+		CrossChannelForward(bottom, top);
+		break;
 	case LRNParameter_NormRegion_WITHIN_CHANNEL:
-		WithinChannelForward(bottom, top);
+		WithinChannelForward_cpu(bottom, top);
 		break;
 	default:
 		LOG(FATAL) << "Unknown normalization region.";
@@ -101,13 +143,67 @@ void LRNLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*>& bottom,
 }
 
 template <typename Dtype>
-void LRNLayer<Dtype>::WithinChannelForward(
+void LRNLayer<Dtype>::CrossChannelForward(
 	const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-	split_layer_->forward(bottom, split_top_vec_);
-	square_layer_->forward(square_bottom_vec_, square_top_vec_);
-	pool_layer_->forward(square_top_vec_, pool_top_vec_);
-	power_layer_->forward(pool_top_vec_, power_top_vec_);
-	product_layer_->forward(product_bottom_vec_, top);
+	const Dtype* bottom_data = bottom[0]->cpu_data();
+	Dtype* top_data = top[0]->mutable_cpu_data();
+	Dtype* scale_data = scale_.mutable_cpu_data();
+	const int dim = height_*width_;
+	const int tiles = (dim + LRN_TILE - 1) / LRN_TILE;
+	const int post_pad = size_ - pre_pad_ - 1;
+	const Dtype alpha_over_size = alpha_ / size_;
+	//	keep a running sum of squares while walking the channels
+	//	each channel adds the square entering the window and subtracts the one leaving it
+	//	so the cost does not depend on local_size
+	dragon_parallel_for(0, num_*tiles, dragon_parallel_grain(channels_*min(dim, LRN_TILE)), [&](int lo, int hi){
+		vector<Dtype> accum(LRN_TILE);
+		for (int item = lo; item < hi; item++){
+			const int n = item / tiles, offset = (item % tiles)*LRN_TILE;
+			const int len = min(LRN_TILE, dim - offset);
+			const Dtype* x = bottom_data + n*channels_*dim + offset;
+			Dtype* scale = scale_data + n*channels_*dim + offset;
+			Dtype* y = top_data + n*channels_*dim + offset;
+			dragon_set(len, Dtype(0), &accum[0]);
+			for (int c = 0; c < post_pad && c < channels_; c++)
+				for (int i = 0; i < len; i++) accum[i] += x[c*dim + i] * x[c*dim + i];
+			for (int c = 0; c < channels_; c++){
+				if (c + post_pad < channels_){
+					const Dtype* head = x + (c + post_pad)*dim;
+					for (int i = 0; i < len; i++) accum[i] += head[i] * head[i];
+				}
+				if (c - pre_pad_ - 1 >= 0){
+					const Dtype* tail = x + (c - pre_pad_ - 1)*dim;
+					for (int i = 0; i < len; i++) accum[i] -= tail[i] * tail[i];
+				}
+				for (int i = 0; i < len; i++) scale[c*dim + i] = k_ + alpha_over_size*accum[i];
+				lrnApply(len, x + c*dim, scale + c*dim, beta_, y + c*dim);
+			}
+		}
+	});
+}
+
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelForward_cpu(
+	const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+	const Dtype* bottom_data = bottom[0]->cpu_data();
+	Dtype* top_data = top[0]->mutable_cpu_data();
+	Dtype* scale_data = scale_.mutable_cpu_data();
+	const int dim = height_*width_;
+	const int post_pad = size_ - pre_pad_ - 1;
+	const Dtype alpha_over_area = alpha_ / (size_*size_);
+	//	scale = 1 + alpha/size^2 * box_sum(x^2), top = x * scale^(-beta)
+	//	what the split/square/avg pooling/power/product layers computed, without their blobs
+	dragon_parallel_for(0, num_*channels_, dragon_parallel_grain(dim), [&](int lo, int hi){
+		vector<Dtype> tmp(dim);
+		for (int plane = lo; plane < hi; plane++){
+			const Dtype* x = bottom_data + plane*dim;
+			Dtype* scale = scale_data + plane*dim;
+			for (int i = 0; i < dim; i++) scale[i] = x[i] * x[i];
+			lrnBoxSum(scale, height_, width_, pre_pad_, post_pad, &tmp[0], scale);
+			for (int i = 0; i < dim; i++) scale[i] = Dtype(1) + alpha_over_area*scale[i];
+			lrnApply(dim, x, scale, beta_, top_data + plane*dim);
+		}
+	});
 }
 
 template <typename Dtype>
@@ -115,16 +211,113 @@ void LRNLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*>& top,
 	const vector<bool>& data_need_bp, const vector<Blob<Dtype>*>& bottom) {
 	switch (param.lrn_param().norm_region()) {
 	case LRNParameter_NormRegion_ACROSS_CHANNELS:
-		NOT_IMPLEMENTED;
+		CrossChannelBackward(top, data_need_bp, bottom);
 		break;
 	case LRNParameter_NormRegion_WITHIN_CHANNEL:
-		WithinChannelBackward(top, data_need_bp, bottom);
+		WithinChannelBackward_cpu(top, data_need_bp, bottom);
 		break;
 	default:
 		LOG(FATAL) << "Unknown normalization region.";
 	}
 }
 
+template <typename Dtype>
+void LRNLayer<Dtype>::CrossChannelBackward(
+	const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp,
+	const vector<Blob<Dtype>*>& bottom) {
+	if (!data_need_bp[0]) return;
+	const Dtype* top_diff = top[0]->cpu_diff();
+	const Dtype* top_data = top[0]->cpu_data();
+	const Dtype* bottom_data = bottom[0]->cpu_data();
+	const Dtype* scale_data = scale_.cpu_data();
+	Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+	const int dim = height_*width_;
+	const int tiles = (dim + LRN_TILE - 1) / LRN_TILE;
+	const int post_pad = size_ - pre_pad_ - 1;
+	const Dtype cache_ratio = Dtype(2) * alpha_ * beta_ / size_;
+	//	bottom_diff = top_diff * scale^(-beta)
+	//				- 2*alpha*beta/size * bottom_data * window_sum(top_diff * top_data / scale)
+	//	the ratios of the window are kept in a ring of size_ rows
+	dragon_parallel_for(0, num_*tiles, dragon_parallel_grain(channels_*min(dim, LRN_TILE)), [&](int lo, int hi){
+		vector<Dtype> accum(LRN_TILE);
+		vector<Dtype> ring(size_*LRN_TILE);
+		for (int item = lo; item < hi; item++){
+			const int n = item / tiles, offset = (item % tiles)*LRN_TILE;
+			const int len = min(LRN_TILE, dim - offset);
+			const int base = n*channels_*dim + offset;
+			const Dtype* dy = top_diff + base;
+			const Dtype* y = top_data + base;
+			const Dtype* x = bottom_data + base;
+			const Dtype* scale = scale_data + base;
+			Dtype* dx = bottom_diff + base;
+			dragon_set(len, Dtype(0), &accum[0]);
+			for (int c = 0; c < pre_pad_ && c < channels_; c++){
+				Dtype* ratio = &ring[(c % size_)*LRN_TILE];
+				for (int i = 0; i < len; i++){
+					ratio[i] = dy[c*dim + i] * y[c*dim + i] / scale[c*dim + i];
+					accum[i] += ratio[i];
+				}
+			}
+			for (int c = 0; c < channels_; c++){
+				//	the leaving row shares the slot with the entering one, subtract it first
+				if (c - post_pad - 1 >= 0){
+					const Dtype* ratio = &ring[((c - post_pad - 1) % size_)*LRN_TILE];
+					for (int i = 0; i < len; i++) accum[i] -= ratio[i];
+				}
+				const int head = c + pre_pad_;
+				if (head < channels_){
+					Dtype* ratio = &ring[(head % size_)*LRN_TILE];
+					for (int i = 0; i < len; i++){
+						ratio[i] = dy[head*dim + i] * y[head*dim + i] / scale[head*dim + i];
+						accum[i] += ratio[i];
+					}
+				}
+				lrnApply(len, dy + c*dim, scale + c*dim, beta_, dx + c*dim);
+				for (int i = 0; i < len; i++) dx[c*dim + i] -= cache_ratio * x[c*dim + i] * accum[i];
+			}
+		}
+	});
+}
+
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelBackward_cpu(
+	const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp,
+	const vector<Blob<Dtype>*>& bottom) {
+	if (!data_need_bp[0]) return;
+	const Dtype* top_diff = top[0]->cpu_diff();
+	const Dtype* top_data = top[0]->cpu_data();
+	const Dtype* bottom_data = bottom[0]->cpu_data();
+	const Dtype* scale_data = scale_.cpu_data();
+	Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+	const int dim = height_*width_;
+	const int post_pad = size_ - pre_pad_ - 1;
+	const Dtype cache_ratio = Dtype(2) * alpha_ * beta_ / (size_*size_);
+	//	the same form as ACROSS_CHANNELS with the spatial window
+	//	the window is symmetric, so the adjoint of the box sum is the box sum itself
+	dragon_parallel_for(0, num_*channels_, dragon_parallel_grain(dim), [&](int lo, int hi){
+		vector<Dtype> tmp(dim), ratio(dim);
+		for (int plane = lo; plane < hi; plane++){
+			const int base = plane*dim;
+			for (int i = 0; i < dim; i++)
+				ratio[i] = top_diff[base + i] * top_data[base + i] / scale_data[base + i];
+			lrnBoxSum(&ratio[0], height_, width_, pre_pad_, post_pad, &tmp[0], &ratio[0]);
+			lrnApply(dim, top_diff + base, scale_data + base, beta_, bottom_diff + base);
+			for (int i = 0; i < dim; i++)
+				bottom_diff[base + i] -= cache_ratio * bottom_data[base + i] * ratio[i];
+		}
+	});
+}
+
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelForward(
+	const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+	split_layer_->forward(bottom, split_top_vec_);
+	square_layer_->forward(square_bottom_vec_, square_top_vec_);
+	pool_layer_->forward(square_top_vec_, pool_top_vec_);
+	power_layer_->forward(pool_top_vec_, power_top_vec_);
+	product_layer_->forward(product_bottom_vec_, top);
+}
+
 template <typename Dtype>
 void LRNLayer<Dtype>::WithinChannelBackward(
 	const vector<Blob<Dtype>*>& top, const vector<bool>& data_need_bp,
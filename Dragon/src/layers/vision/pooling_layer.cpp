@@ -1,4 +1,5 @@
 #include "layers/vision/pooling_layer.hpp"
+#include "utils/thread_pool.hpp"
 
 template<typename Dtype>
 void PoolingLayer<Dtype>::layerSetup(const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top){
@@ -90,6 +91,12 @@ void PoolingLayer<Dtype>::reshape(const vector<Blob<Dtype>*> &bottom, const vect
 		max_idx.reshape(bottom[0]->num(), channels, pooling_height, pooling_width);
 	if (pool_param.method() == PoolingParameter_Method_STOCHASTIC)
 		rand_idx.reshapeLike(*top[0]);
+	pool_kernel = select_pooling_kernel(kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, global_pooling);
+	use_window_mask = pool_param.method() == PoolingParameter_Method_MAX && top.size() == 1
+		&& kernel_h*kernel_w <= POOLING_MAX_MASK_WINDOW;
+	//	grow only, allocated at the first CPU forward
+	if (use_window_mask && (!window_mask || window_mask->size() < top[0]->count()))
+		window_mask.reset(new SyncedMemory(top[0]->count()));
 }
 
 template<typename Dtype>
@@ -97,16 +104,32 @@ void PoolingLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom, const
 	PoolingParameter pool_param = param.pooling_param();
 	const Dtype* bottom_data = bottom[0]->cpu_data();
 	Dtype* top_data = top[0]->mutable_cpu_data();
-	const int top_count = top[0]->count();
 	const bool use_top_mask = top.size() > 1;
 	int *mask = NULL;
 	Dtype *top_mask = NULL;
+	//	every (n,c) plane is pooled independently, split them across the pool
+	const int num_planes = bottom[0]->num()*channels;
+	const int bottom_dim = bottom[0]->offset(0, 1);
+	const int top_dim = top[0]->offset(0, 1);
+	const int grain = dragon_parallel_grain(bottom_dim + top_dim);
 	switch (pool_param.method()){
 	case PoolingParameter_Method_MAX:
+		if (use_window_mask){
+			unsigned char* window = (unsigned char*)window_mask->mutable_cpu_data();
+			dragon_parallel_for(0, num_planes, grain, [&](int lo, int hi){
+				max_pool_cpu(pool_kernel, bottom_data + lo*bottom_dim, hi - lo, height, width,
+					kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, pooling_height, pooling_width,
+					top_data + lo*top_dim, window + lo*top_dim);
+			});
+			break;
+		}
+		//	the absolute index of the max in the plane
 		if (use_top_mask) top_mask = top[1]->mutable_cpu_data();
 		else mask = max_idx.mutable_cpu_data();
-		for (int n = 0; n < bottom[0]->num(); n++){
-			for (int c = 0; c < channels; c++){
+		dragon_parallel_for(0, num_planes, grain, [&](int lo, int hi){
+			for (int nc = lo; nc < hi; nc++){
+				const Dtype* bottom_plane = bottom_data + nc*bottom_dim;
+				Dtype* top_plane = top_data + nc*top_dim;
 				for (int ph = 0; ph < pooling_height; ph++){
 					for (int pw = 0; pw < pooling_width; pw++){
 						//	compute the start position
@@ -123,67 +146,33 @@ void PoolingLayer<Dtype>::forward_cpu(const vector<Blob<Dtype>*> &bottom, const
 						const int pool_idx = ph*pooling_width + pw;
 						//	for a fixed data and channel
 						//	we scan the max val and log the idx for diff_computing
-						//	note that bottom/top_data will offset later
 						Dtype max_val = -FLT_MAX;
 						int max_idx = -1;
 						for (int h = start_h; h < end_h; h++){
 							for (int w = start_w; w < end_w; w++){
 								//	idx represents the y_th im unit which the x_th output unit used
 								const int idx = h*width + w;
-								if (bottom_data[idx]>max_val){
-									max_val = bottom_data[idx];
+								if (bottom_plane[idx]>max_val){
+									max_val = bottom_plane[idx];
 									max_idx = idx;
 								}
 							}	//	end w
 						}	//	end h
-						top_data[pool_idx] = max_val;
-						if (use_top_mask) top_mask[pool_idx] = max_idx;
-						else mask[pool_idx] = max_idx;
+						top_plane[pool_idx] = max_val;
+						if (use_top_mask) top_mask[nc*top_dim + pool_idx] = max_idx;
+						else mask[nc*top_dim + pool_idx] = max_idx;
 					}	//	end pw
 				}	//	end ph
-				//	offset a channel
-				bottom_data += bottom[0]->offset(0, 1);
-				top_data += top[0]->offset(0, 1);
-				if (use_top_mask) top_mask += top[0]->offset(0, 1);
-				else mask += top[0]->offset(0, 1);
-			}	//	end c
-		}	//	end n
+			}	//	end nc
+		});
 		break;
 
 	case PoolingParameter_Method_AVG:
-		dragon_set(top_count, Dtype(0), top_data);
-		for (int n = 0; n < bottom[0]->num(); n++){
-			for (int c = 0; c < channels; c++){
-				for (int ph = 0; ph < pooling_height; ph++){
-					for (int pw = 0; pw < pooling_width; pw++){
-						int start_h = ph*stride_h - pad_h;
-						int start_w = pw*stride_w - pad_w;
-						int end_h = min(start_h + kernel_h, height + pad_h);
-						int end_w = min(start_w + kernel_w, width + pad_w);
-						//	before cilp we need compute the pool area for average
-						int pool_area = (end_h - start_h)*(end_w - start_w);
-						//	clip
-						end_h = min(end_h, height);
-						end_w = min(end_w, width);
-						start_h = max(start_h, 0);
-						start_w = max(start_w, 0);
-						const int pool_idx = ph*pooling_width + pw;
-						//	sum up all units in the area
-						for (int h = start_h; h < end_h; h++){
-							for (int w = start_w; w < end_w; w++){
-								const int idx = h*width + w;
-								top_data[pool_idx] += bottom_data[idx];
-							}
-						}
-						//	do average
-						top_data[pool_idx] /= pool_area;
-						//	note that AVG pooling need not log the idx for diff_computing
-					}	//end pw
-				}	//end ph
-				bottom_data += bottom[0]->offset(0, 1);
-				top_data += top[0]->offset(0, 1);
-			}	//end c
-		}	//end n
+		dragon_parallel_for(0, num_planes, grain, [&](int lo, int hi){
+			avg_pool_cpu(pool_kernel, bottom_data + lo*bottom_dim, hi - lo, height, width,
+				kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, pooling_height, pooling_width,
+				top_data + lo*top_dim);
+		});
 		break;
 
 	case PoolingParameter_Method_STOCHASTIC:
@@ -203,71 +192,52 @@ void PoolingLayer<Dtype>::backward_cpu(const vector<Blob<Dtype>*> &top,
 	PoolingParameter pool_param = param.pooling_param();
 	const Dtype* top_diff = top[0]->cpu_diff();
 	Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+	//	non-contributed bottom_diff will keep zero
 	dragon_set(bottom[0]->count(), Dtype(0), bottom_diff);
 	const bool use_top_mask = top.size() > 1;
 	const int* mask = NULL;
 	const Dtype* top_mask = NULL;
+	const int num_planes = bottom[0]->num()*channels;
+	const int bottom_dim = bottom[0]->offset(0, 1);
+	const int top_dim = top[0]->offset(0, 1);
+	const int grain = dragon_parallel_grain(bottom_dim + top_dim);
+	//	note that we allow overlapping pooling
+	//	it means that different top_diffs may have a same bottom_diff
+	//	so all kernels accumulate with '+=', planes never overlap so they can be split
 	switch (pool_param.method()){
 	case PoolingParameter_Method_MAX:
+		if (use_window_mask){
+			const unsigned char* window = (const unsigned char*)window_mask->cpu_data();
+			dragon_parallel_for(0, num_planes, grain, [&](int lo, int hi){
+				max_pool_backward_cpu(pool_kernel, top_diff + lo*top_dim, window + lo*top_dim, hi - lo,
+					height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+					pooling_height, pooling_width, bottom_diff + lo*bottom_dim);
+			});
+			break;
+		}
 		if (use_top_mask) top_mask = top[1]->cpu_data();
 		else mask = max_idx.cpu_data();
-		for (int n = 0; n < bottom[0]->num(); n++){
-			for (int c = 0; c < channels; c++){
-				for (int ph = 0; ph < pooling_height; ph++){
-					for (int pw = 0; pw < pooling_width; pw++){
-						const int pool_idx = ph*pooling_width + pw;
-						const int idx = use_top_mask ? top_mask[pool_idx] : mask[pool_idx];
-						//	bottom_diff += delta_(layer+1)
-						//	note that we allow overlapping pooling
-						//	it means that different top_diffs may have a same bottom_diff
-						//	because bottom_diff may overlap
-						//	use '+=' replace '=' if using overlapping pooling
-						//	also, using idx can consider as to decide a contributed bottom_diff
-						//	backward the sub gradient only to the contributed bottom_diff
-						//	non-contributed bottom_diff will keep zero which is setted in dragon_set()
-						bottom_diff[idx] += top_diff[pool_idx];
-					}	//	end pw
-				}//	end ph
-				bottom_diff += bottom[0]->offset(0, 1);
-				top_diff += top[0]->offset(0, 1);
-				if (use_top_mask) top_mask += top[0]->offset(0, 1);
-				else mask += top[0]->offset(0, 1);
-			}	// end c
-		}//	end n
+		dragon_parallel_for(0, num_planes, grain, [&](int lo, int hi){
+			for (int nc = lo; nc < hi; nc++){
+				for (int pool_idx = nc*top_dim; pool_idx < (nc + 1)*top_dim; pool_idx++){
+					//	idx decides the contributed bottom_diff
+					//	backward the sub gradient only to it
+					const int idx = use_top_mask ? top_mask[pool_idx] : mask[pool_idx];
+					bottom_diff[nc*bottom_dim + idx] += top_diff[pool_idx];
+				}
+			}
+		});
 		break;
 
 	case PoolingParameter_Method_AVG:
-		for (int n = 0; n < bottom[0]->num(); n++){
-			for (int c = 0; c < channels; c++){
-				for (int ph = 0; ph < pooling_height; ph++){
-					for (int pw = 0; pw < pooling_width; pw++){
-						int start_h = ph*stride_h - pad_h;
-						int start_w = pw*stride_w - pad_w;
-						int end_h = min(start_h + kernel_h, height + pad_h);
-						int end_w = min(start_w + kernel_w, width + pad_w);
-						//	before cilp we need compute the pool area for average
-						int pool_area = (end_h - start_h)*(end_w - start_w);
-						//	clip
-						end_h = min(end_h, height);
-						end_w = min(end_w + kernel_w, width);
-						start_h = max(start_h, 0);
-						start_w = max(start_w, 0);
-						const int pool_idx = ph*pooling_width + pw;
-						//	1/(pool_area)*bottom_data=top_data
-						//  d(top_data)/d(bottom_data)=1/(pool_area)
-						//	combine with sub gradient and we get 'top_diff[pool_idx] / pool_area'
-						for (int h = start_h; h < end_h; h++){
-							for (int w = start_w; w < end_w; w++){
-								const int idx = h*width + w;
-								bottom_diff[idx] += (top_diff[pool_idx] / pool_area);
-							}
-						}
-					}	//	end pw
-				}//	end ph
-				bottom_diff += bottom[0]->offset(0, 1);
-				top_diff += top[0]->offset(0, 1);
-			}	// end c
-		}//	end n
+		//	1/(pool_area)*bottom_data=top_data
+		//  d(top_data)/d(bottom_data)=1/(pool_area)
+		//	combine with sub gradient and we get 'top_diff[pool_idx] / pool_area'
+		dragon_parallel_for(0, num_planes, grain, [&](int lo, int hi){
+			avg_pool_backward_cpu(pool_kernel, top_diff + lo*top_dim, hi - lo, height, width,
+				kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, pooling_height, pooling_width,
+				bottom_diff + lo*bottom_dim);
+		});
 		break;
 
 	case PoolingParameter_Method_STOCHASTIC:
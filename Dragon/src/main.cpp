@@ -5,6 +5,12 @@
 #include "layer_factory.hpp"
 #include "dragon_thread.hpp"
 #include "utils/io.hpp"
+#include "utils/timer.hpp"
+#include "syncedmem.hpp"
+#include "utils/im2col.hpp"
+#include "utils/winograd.hpp"
+#include "utils/blocking_queue.hpp"
+#include "utils/ring_queue.hpp"
 #pragma warning(disable:4099)
 
 //	define format(name , default value, help string)
@@ -23,6 +29,9 @@ DEFINE_string(weights, "",
 	"separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
 	"The number of iterations to run.");
+DEFINE_int32(threads, 0,
+	"Optional; the intra-op threads of the CPU kernels and OpenBLAS. "
+	"Overrides the solver's num_threads, 0 keeps all the cores.");
 typedef int(*FUNC)();
 typedef map<string, FUNC> ArgFactory;
 ArgFactory arg_factory;
@@ -72,6 +81,7 @@ int train(){
 		<< "snapshot and weights can not be specified both.";
 	SolverParameter solver_param;
 	readSolverParamsFromTextFileOrDie(FLAGS_solver, &solver_param);
+	if (FLAGS_threads > 0) solver_param.set_num_threads(FLAGS_threads);
 
 	//	add device id from solver param if necessary
 	if (FLAGS_gpu.size() == 0 &&
@@ -126,6 +136,207 @@ int train(){
 }
 
 RegisterArgFunction(train);
+
+//	run a statement FLAGS_iterations times and report the average time
+#define BENCHMARK(name, statement) \
+	do { \
+		statement; \
+		Timer timer; \
+		for (int iter = 0; iter < FLAGS_iterations; iter++) { statement; } \
+		LOG(INFO) << name << ": " << timer.milliSeconds() / FLAGS_iterations << " ms"; \
+	} while (0)
+
+//	compare aligned buffers with the ones shifted by an element
+//	which is what plain malloc may return
+int bench_math(){
+	const int M = 256, N = M * M;
+	void *a_ptr, *b_ptr, *c_ptr;
+	const size_t size = (N + DRAGON_MALLOC_ALIGN) * sizeof(float);
+	dragonMalloc(&a_ptr, size);
+	dragonMalloc(&b_ptr, size);
+	dragonMalloc(&c_ptr, size);
+	dragon_rng_uniform<float>(N + 1, 0.5, 1.5, (float*)a_ptr);
+	dragon_rng_uniform<float>(N + 1, 0.5, 1.5, (float*)b_ptr);
+	for (int shift = 0; shift < 2; shift++){
+		const float* a = (float*)a_ptr + shift;
+		const float* b = (float*)b_ptr + shift;
+		float* c = (float*)c_ptr + shift;
+		LOG(INFO) << (shift ? "Misaligned" : "Aligned") << " buffers:";
+		BENCHMARK("	gemm " << M << "x" << M << "x" << M,
+			dragon_cpu_gemm<float>(CblasNoTrans, CblasNoTrans, M, M, M, 1.0, a, b, 0.0, c));
+		BENCHMARK("	exp " << N, dragon_exp<float>(N, a, c));
+		BENCHMARK("	powx " << N, dragon_powx<float>(N, a, 0.75, c));
+		BENCHMARK("	mul " << N, dragon_mul<float>(N, a, b, c));
+		BENCHMARK("	add " << N, dragon_add<float>(N, a, b, c));
+		BENCHMARK("	div " << N, dragon_div<float>(N, a, b, c));
+	}
+	dragonFree(a_ptr, size);
+	dragonFree(b_ptr, size);
+	dragonFree(c_ptr, size);
+	return 0;
+}
+
+RegisterArgFunction(bench_math);
+
+//	the element-wise im2col which was replaced by the row-copy version
+template<typename Dtype>
+static void im2col_reference(const Dtype* im, const int channels, const int height, const int width,
+	const int kernel, const int pad, const int stride, Dtype* col){
+	const int col_h = (height + 2 * pad - kernel) / stride + 1;
+	const int col_w = (width + 2 * pad - kernel) / stride + 1;
+	for (int c = 0; c < channels*kernel*kernel; c++){
+		const int w_off = c % kernel, h_off = (c / kernel) % kernel, im_c = c / kernel / kernel;
+		for (int h = 0; h < col_h; h++){
+			for (int w = 0; w < col_w; w++){
+				const int im_h = h*stride - pad + h_off, im_w = w*stride - pad + w_off;
+				col[(c*col_h + h)*col_w + w] = (im_h >= 0 && im_w >= 0 && im_h < height && im_w < width) ?
+					im[(im_c*height + im_h)*width + im_w] : 0;
+			}
+		}
+	}
+}
+
+//	im2col/col2im over common conv shapes
+int bench_im2col(){
+	//	channels, size, kernel, pad, stride
+	const int shapes[][5] = {
+		{ 3, 224, 7, 3, 2 }, { 64, 56, 3, 1, 1 }, { 128, 28, 3, 1, 1 },
+		{ 256, 14, 3, 1, 1 }, { 512, 7, 3, 1, 1 }, { 128, 56, 3, 1, 2 } };
+	for (int i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++){
+		const int channels = shapes[i][0], size = shapes[i][1];
+		const int kernel = shapes[i][2], pad = shapes[i][3], stride = shapes[i][4];
+		const int col_size = (size + 2 * pad - kernel) / stride + 1;
+		vector<int> im_shape(3), col_shape(3);
+		im_shape[0] = channels; im_shape[1] = im_shape[2] = size;
+		col_shape[0] = channels*kernel*kernel; col_shape[1] = col_shape[2] = col_size;
+		//	every version writes its own buffer, so they can be compared afterwards
+		Blob<float> im(im_shape), col_im(im_shape), ref_col(col_shape), col(col_shape), nd_col(col_shape);
+		dragon_rng_uniform<float>(im.count(), -1, 1, im.mutable_cpu_data());
+		const float* im_data = im.cpu_data();
+		float* ref_col_data = ref_col.mutable_cpu_data();
+		float* col_data = col.mutable_cpu_data();
+		float* nd_col_data = nd_col.mutable_cpu_data();
+		LOG(INFO) << channels << "x" << size << "x" << size << " kernel " << kernel
+			<< " pad " << pad << " stride " << stride << ":";
+		BENCHMARK("	reference im2col", im2col_reference(im_data, channels, size, size, kernel, pad, stride, ref_col_data));
+		BENCHMARK("	im2col", im2col_cpu(im_data, channels, size, size, kernel, kernel, pad, pad, stride, stride, col_data));
+		BENCHMARK("	col2im", col2im_cpu(col_data, channels, size, size, kernel, kernel, pad, pad, stride, stride,
+			col_im.mutable_cpu_data()));
+		const int kernel_shape[2] = { kernel, kernel }, pads[2] = { pad, pad }, strides[2] = { stride, stride };
+		BENCHMARK("	im2col_nd", im2col_nd_cpu(im_data, 2, &im_shape[0], &col_shape[0], kernel_shape, pads, strides, nd_col_data));
+		//	all of them only copy the pixels, so they must agree exactly
+		for (int j = 0; j < col.count(); j++){
+			CHECK_EQ(col_data[j], ref_col_data[j]) << "im2col differs from the reference at " << j;
+			CHECK_EQ(nd_col_data[j], ref_col_data[j]) << "im2col_nd differs from the reference at " << j;
+		}
+	}
+	return 0;
+}
+
+RegisterArgFunction(bench_im2col);
+
+//	max error relative to the largest reference value
+static float relative_error(const vector<float>& ref, const vector<float>& val){
+	float error = 0, scale = 1;
+	for (int i = 0; i < ref.size(); i++){
+		error = max(error, fabs(ref[i] - val[i]));
+		scale = max(scale, fabs(ref[i]));
+	}
+	return error / scale;
+}
+
+//	Winograd F(2x2)/F(4x4) against im2col+gemm, forward and backward-data
+//	the sizes are not multiples of the tiles, so the partial tiles are covered
+int check_winograd(){
+	const int num = 2, channels = 16, out_channels = 8, height = 13, width = 11;
+	//	F(4x4) loses more precision in its transforms
+	const float tolerances[] = { 1e-5f, 1e-4f };
+	const int ms[] = { 2, 4 };
+	vector<float> weights(out_channels*channels * 9);
+	dragon_rng_uniform<float>(weights.size(), -1, 1, &weights[0]);
+	for (int pad = 0; pad <= 2; pad++){
+		const int out_height = height + 2 * pad - 2, out_width = width + 2 * pad - 2;
+		const int in_dim = channels*height*width, out_dim = out_channels*out_height*out_width;
+		vector<float> im(num*in_dim), top_diff(num*out_dim), col(channels * 9 * out_height*out_width);
+		dragon_rng_uniform<float>(im.size(), -1, 1, &im[0]);
+		dragon_rng_uniform<float>(top_diff.size(), -1, 1, &top_diff[0]);
+		vector<float> top(num*out_dim), bottom_diff(num*in_dim);
+		for (int n = 0; n < num; n++){
+			im2col_cpu(&im[n*in_dim], channels, height, width, 3, 3, pad, pad, 1, 1, &col[0]);
+			dragon_cpu_gemm<float>(CblasNoTrans, CblasNoTrans, out_channels, out_height*out_width, channels * 9,
+				1.0, &weights[0], &col[0], 0.0, &top[n*out_dim]);
+			dragon_cpu_gemm<float>(CblasTrans, CblasNoTrans, channels * 9, out_height*out_width, out_channels,
+				1.0, &weights[0], &top_diff[n*out_dim], 0.0, &col[0]);
+			col2im_cpu(&col[0], channels, height, width, 3, 3, pad, pad, 1, 1, &bottom_diff[n*in_dim]);
+		}
+		for (int i = 0; i < 2; i++){
+			const int m = ms[i], tiles = (m + 2)*(m + 2);
+			vector<float> transformed(tiles*out_channels*channels), flipped(tiles*out_channels*channels);
+			winograd_transform_weights(&weights[0], out_channels, channels, m, false, &transformed[0]);
+			winograd_transform_weights(&weights[0], out_channels, channels, m, true, &flipped[0]);
+			vector<float> workspace(max(winograd_workspace_count(num, channels, out_channels, out_height, out_width, m),
+				winograd_workspace_count(num, out_channels, channels, height, width, m)));
+			vector<float> winograd_top(num*out_dim), winograd_bottom_diff(num*in_dim);
+			winograd_conv_cpu(&im[0], num, channels, height, width, pad, pad, &transformed[0], out_channels, m,
+				&winograd_top[0], &workspace[0]);
+			//	the data gradient is a full convolution with the flipped kernels
+			winograd_conv_cpu(&top_diff[0], num, out_channels, out_height, out_width, 2 - pad, 2 - pad,
+				&flipped[0], channels, m, &winograd_bottom_diff[0], &workspace[0]);
+			const float forward_error = relative_error(top, winograd_top);
+			const float backward_error = relative_error(bottom_diff, winograd_bottom_diff);
+			LOG(INFO) << "F(" << m << "x" << m << ") pad " << pad << ": forward error " << forward_error
+				<< ", backward-data error " << backward_error;
+			CHECK_LE(forward_error, tolerances[i]) << "Winograd F(" << m << "x" << m << ") forward is wrong.";
+			CHECK_LE(backward_error, tolerances[i]) << "Winograd F(" << m << "x" << m << ") backward-data is wrong.";
+		}
+	}
+	LOG(INFO) << "Winograd matches im2col.";
+	return 0;
+}
+
+RegisterArgFunction(check_winograd);
+
+//	pass items from the producers to the consumers, return the milliseconds
+template <typename Queue>
+static double pass_items(Queue& queue, const int producers, const int consumers, const int items){
+	boost::thread_group threads;
+	Timer timer;
+	for (int i = 0; i < producers; i++)
+		threads.create_thread([&queue, producers, items]{
+			for (int j = 0; j < items / producers; j++) queue.push(j);
+		});
+	for (int i = 0; i < consumers; i++)
+		threads.create_thread([&queue, consumers, items]{
+			for (int j = 0; j < items / consumers; j++) queue.pop();
+		});
+	threads.join_all();
+	return timer.milliSeconds();
+}
+
+//	BlockingQueue against the rings under contention
+int bench_queue(){
+	const int items = 1 << 20, capacity = 1024;
+	LOG(INFO) << "Passing " << items << " items:";
+	{
+		BlockingQueue<int> queue;
+		SPSCRing<int> ring(capacity);
+		const double queue_time = pass_items(queue, 1, 1, items);
+		const double ring_time = pass_items(ring, 1, 1, items);
+		LOG(INFO) << "	1 producer/1 consumer: BlockingQueue " << queue_time << " ms, SPSCRing " << ring_time << " ms";
+	}
+	for (int threads = 2; threads <= 8; threads *= 2){
+		BlockingQueue<int> queue;
+		MPMCRing<int> ring(capacity);
+		const double queue_time = pass_items(queue, threads, threads, items);
+		const double ring_time = pass_items(ring, threads, threads, items);
+		LOG(INFO) << "	" << threads << " producers/" << threads << " consumers: BlockingQueue "
+			<< queue_time << " ms, MPMCRing " << ring_time << " ms";
+	}
+	return 0;
+}
+
+RegisterArgFunction(bench_queue);
+
 void globalInit(int* argc, char*** argv){
 	gflags::ParseCommandLineFlags(argc, argv, true);
 	google::InitGoogleLogging(*(argv)[0]);
@@ -135,7 +346,10 @@ void globalInit(int* argc, char*** argv){
 int main(int argc,char* argv[]){
 	//	Initialize Google's logging library.
 	globalInit(&argc, &argv);
-	//	if (argc == 2) return getArgFunction(string(argv[1]))();
+	if (FLAGS_threads > 0) Dragon::set_num_threads(FLAGS_threads);
+	//	run a registered action instead of training
+	//	e.g. dragon check_winograd, dragon bench_math -iterations 100
+	if (argc == 2) return getArgFunction(string(argv[1]))();
 	train();
 	while (1) {}
 }
@@ -2,6 +2,7 @@
 #include "layer_factory.hpp"
 #include "utils/insert_splits.hpp"
 #include "utils/io.hpp"
+#include "utils/workspace.hpp"
 
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param, const Net* root_net):
@@ -19,6 +20,12 @@ Net<Dtype>::Net(const string& param_file, Phase phase, const Net* root_net = NUL
 	Init(param);
 }
 
+template <typename Dtype>
+Net<Dtype>::~Net(){
+	//	the scratch of the conv layers is not needed without any net
+	Workspace::Get().detach();
+}
+
 template <typename Dtype>
 bool Net<Dtype>::stateMeetRule(const NetState& state, const NetStateRule& rule, const string& name){
 	//	check phase
@@ -245,9 +252,22 @@ void Net<Dtype>::Init(const NetParameter& in_param){
 	CHECK(Dragon::get_root_solver() || root_net)
 		<< "Root net need to be set for all non-root solvers.";
 	phase = in_param.state().phase();
+	Workspace::Get().attach();
 	NetParameter filtered_param, param;
 	//	filter for unqualified LayerParameters(e.g Test DataLayer)
 	filterNet(in_param, &filtered_param);
+	folded_layers.clear();
+	if (phase == TEST && filtered_param.fold_inference()){
+		NetParameter folded_param;
+		foldInference(filtered_param, &folded_param);
+		filtered_param.CopyFrom(folded_param);
+	}
+	//	the GPU kernels do not know the fused ReLU
+	if (filtered_param.fuse_relu() && Dragon::get_mode() == Dragon::CPU){
+		NetParameter fused_param;
+		fuseReLU(filtered_param, &fused_param);
+		filtered_param.CopyFrom(fused_param);
+	}
 	insertSplits(filtered_param, &param);
 	name = param.name();
 	LOG_IF(INFO, Dragon::get_root_solver())
@@ -427,21 +447,414 @@ void Net<Dtype>::Init(const NetParameter& in_param){
 	//	store layer_name -> layer_id
 	for (size_t layer_id = 0; layer_id < layer_names.size(); layer_id++)
 		layers_name_idx[layer_names[layer_id]] = layer_id;
+	if (folded_layers.size()){
+		//	fold the weights now if the params come with the net
+		//	otherwise copyTrainedLayerFrom() does it
+		set<string> producers, waiting;
+		for (int i = 0; i < folded_layers.size(); i++){
+			if (folded_layers[i].loaded) producers.insert(folded_layers[i].producer);
+			else waiting.insert(folded_layers[i].producer);
+		}
+		for (set<string>::iterator i = waiting.begin(); i != waiting.end(); i++) producers.erase(*i);
+		foldWeights(producers);
+		//	estimated per forward: BatchNorm costs sub/mul/add and Power mul/add for each element
+		//	a folded layer which is not in-place also drops its top
+		long long flops = 0;
+		size_t bytes = 0;
+		for (int i = 0; i < folded_layers.size(); i++){
+			const int producer_id = layers_name_idx[folded_layers[i].producer];
+			const int count = top_vecs[producer_id][0]->count();
+			flops += (long long)(folded_layers[i].param.type() == "BatchNorm" ? 3 : 2) * count;
+			if (!folded_layers[i].in_place) bytes += count*sizeof(Dtype);
+		}
+		LOG_IF(INFO, Dragon::get_root_solver())
+			<< "Folded " << folded_layers.size() << " layers, saved about "
+			<< flops << " FLOPs and " << bytes << " bytes of activations per forward";
+	}
+	//	unknown signatures, the first forward reshapes all layers
+	bottom_shapes.assign(layers.size(), vector<int>(1, -1));
 	debug_info = param.debug_info();
+	optimize_memory = param.optimize_memory();
+	//	inference nets only keep the frontier of activations
+	//	debug_info needs all blobs to dump
+	bool need_backward = false;
+	for (int layer_id = 0; layer_id < layers.size(); layer_id++)
+		need_backward |= layer_need_backward[layer_id];
+	const size_t released = releaseUnusedDiffs();
+	LOG_IF(INFO, Dragon::get_root_solver() && released)
+		<< "Released " << released << " bytes of diffs which backward never uses";
+	if (optimize_memory && !debug_info){
+		//	activations/diffs of activations both cost memory_used
+		const size_t required = memory_used*sizeof(Dtype)*(need_backward ? 2 : 1);
+		size_t saved = 0;
+		if (need_backward) saved += planDiffMemory();
+		else if (phase == TEST) saved += planDataMemory();
+		LOG_IF(INFO, Dragon::get_root_solver())
+			<< "Memory required for Data: " << required - saved
+			<< " (" << saved << " saved by sharing)";
+	}
 	LOG_IF(INFO, Dragon::get_root_solver()) << "Network Initializion done.";
 }
 
+template <typename Dtype>
+size_t Net<Dtype>::planDataMemory(){
+	const int num_blobs = blobs.size();
+	//	tops that only alias other blobs(e.g. SplitLayer/ReshapeLayer)
+	//	follow the blob which really holds the memory
+	vector<int> root(num_blobs);
+	vector<bool> plannable(num_blobs, true);
+	for (int i = 0; i < num_blobs; i++) root[i] = i;
+	//	the outside world reads/writes them
+	for (int i = 0; i < net_input_blob_indices.size(); i++) plannable[net_input_blob_indices[i]] = false;
+	for (int i = 0; i < net_output_blob_indices.size(); i++) plannable[net_output_blob_indices[i]] = false;
+	for (int i = 0; i < num_blobs; i++)
+		if (i < blobs_loss_weight.size() && blobs_loss_weight[i]) plannable[i] = false;
+	for (int layer_id = 0; layer_id < layers.size(); layer_id++){
+		const vector<Blob<Dtype>*>& bottom = bottom_vecs[layer_id];
+		const vector<Blob<Dtype>*>& top = top_vecs[layer_id];
+		for (int top_id = 0; top_id < top.size(); top_id++){
+			const int blob_id = top_id_vecs[layer_id][top_id];
+			//	tops of data layers are filled by the prefetching threads
+			if (bottom.empty()){
+				plannable[blob_id] = false;
+				continue;
+			}
+			int alias = -1;
+			if (layers[layer_id]->forwardSharesData()) alias = bottom_id_vecs[layer_id][0];
+			//	shared after setup(e.g. ReshapeLayer)
+			for (int bottom_id = 0; bottom_id < bottom.size(); bottom_id++)
+				if (bottom[bottom_id] != top[top_id] && bottom[bottom_id]->data() == top[top_id]->data())
+					alias = bottom_id_vecs[layer_id][bottom_id];
+			if (alias >= 0 && alias != blob_id) root[blob_id] = root[alias];
+		}
+	}
+	//	an alias can not be shared, so can not its root
+	for (int i = 0; i < num_blobs; i++)
+		if (!plannable[i]) plannable[root[i]] = false;
+	//	lifetime: [the producer, the last consumer]
+	vector<int> first(num_blobs, -1), last(num_blobs, -1);
+	for (int layer_id = 0; layer_id < layers.size(); layer_id++){
+		for (int top_id = 0; top_id < top_id_vecs[layer_id].size(); top_id++){
+			const int r = root[top_id_vecs[layer_id][top_id]];
+			if (first[r] < 0) first[r] = layer_id;
+			last[r] = layer_id;
+		}
+		for (int bottom_id = 0; bottom_id < bottom_id_vecs[layer_id].size(); bottom_id++){
+			const int r = root[bottom_id_vecs[layer_id][bottom_id]];
+			last[r] = layer_id;
+		}
+	}
+	MemoryPlanner planner;
+	vector<int> request_ids(num_blobs, -1);
+	for (int i = 0; i < num_blobs; i++){
+		if (root[i] != i || !plannable[i] || first[i] < 0 || !blobs[i]->count()) continue;
+		request_ids[i] = planner.add(first[i], last[i], blobs[i]->count()*sizeof(Dtype));
+	}
+	planner.plan();
+	data_slots.clear();
+	for (int i = 0; i < planner.numSlots(); i++)
+		data_slots.push_back(boost::shared_ptr<SyncedMemory>(new SyncedMemory(planner.slotSize(i))));
+	for (int i = 0; i < num_blobs; i++)
+		if (request_ids[i] >= 0) blobs[i]->shareData(data_slots[planner.slot(request_ids[i])]);
+	return planner.requestedSize() - planner.plannedSize();
+}
+
+template <typename Dtype>
+size_t Net<Dtype>::releaseUnusedDiffs(){
+	size_t bytes = 0;
+	for (int i = 0; i < blobs.size(); i++){
+		if (blobs_need_backward[i] || !blobs[i]->has_diff()) continue;
+		//	a shared diff is only freed with its last owner
+		if (blobs[i]->diff().unique()) bytes += blobs[i]->diff()->size();
+		blobs[i]->releaseDiff();
+	}
+	return bytes;
+}
+
+template <typename Dtype>
+size_t Net<Dtype>::planDiffMemory(){
+	const int num_blobs = blobs.size();
+	//	tops sharing the diff with a bottom(e.g. ReshapeLayer) follow the bottom
+	//	note that tops of SplitLayer have their own diffs
+	vector<int> root(num_blobs);
+	vector<bool> plannable(num_blobs, true);
+	for (int i = 0; i < num_blobs; i++) root[i] = i;
+	//	diffs of inputs/outputs are read/written by the outside world
+	//	diffs of loss blobs hold the loss weights
+	for (int i = 0; i < net_input_blob_indices.size(); i++) plannable[net_input_blob_indices[i]] = false;
+	for (int i = 0; i < net_output_blob_indices.size(); i++) plannable[net_output_blob_indices[i]] = false;
+	for (int i = 0; i < num_blobs; i++)
+		if (i < blobs_loss_weight.size() && blobs_loss_weight[i]) plannable[i] = false;
+	for (int layer_id = 0; layer_id < layers.size(); layer_id++){
+		const vector<Blob<Dtype>*>& bottom = bottom_vecs[layer_id];
+		const vector<Blob<Dtype>*>& top = top_vecs[layer_id];
+		for (int top_id = 0; top_id < top.size(); top_id++){
+			const int blob_id = top_id_vecs[layer_id][top_id];
+			for (int bottom_id = 0; bottom_id < bottom.size(); bottom_id++){
+				const int alias = bottom_id_vecs[layer_id][bottom_id];
+				//	do not allocate the diffs only to compare them
+				if (alias != blob_id && bottom[bottom_id]->has_diff() && top[top_id]->has_diff()
+					&& bottom[bottom_id]->diff() == top[top_id]->diff())
+					root[blob_id] = root[alias];
+			}
+		}
+	}
+	for (int i = 0; i < num_blobs; i++)
+		if (!plannable[i]) plannable[root[i]] = false;
+	//	backward runs from the last layer to the first one
+	//	a diff is written by the backward of consumers and read by the backward of the producer
+	//	so it is alive in [the producer, the last consumer] as well(in the reversed order)
+	vector<int> first(num_blobs, -1), last(num_blobs, -1);
+	for (int layer_id = 0; layer_id < layers.size(); layer_id++){
+		if (!layer_need_backward[layer_id]) continue;
+		for (int top_id = 0; top_id < top_id_vecs[layer_id].size(); top_id++){
+			const int r = root[top_id_vecs[layer_id][top_id]];
+			if (first[r] < 0) first[r] = layer_id;
+			last[r] = layer_id;
+		}
+		for (int bottom_id = 0; bottom_id < bottom_id_vecs[layer_id].size(); bottom_id++){
+			if (!bottoms_need_backward[layer_id][bottom_id]) continue;
+			const int r = root[bottom_id_vecs[layer_id][bottom_id]];
+			if (first[r] < 0) first[r] = layer_id;
+			last[r] = layer_id;
+		}
+	}
+	MemoryPlanner planner;
+	vector<int> request_ids(num_blobs, -1);
+	for (int i = 0; i < num_blobs; i++){
+		if (root[i] != i || !plannable[i] || first[i] < 0 || !blobs[i]->count()) continue;
+		request_ids[i] = planner.add(first[i], last[i], blobs[i]->count()*sizeof(Dtype));
+	}
+	planner.plan();
+	diff_slots.clear();
+	for (int i = 0; i < planner.numSlots(); i++)
+		diff_slots.push_back(boost::shared_ptr<SyncedMemory>(new SyncedMemory(planner.slotSize(i))));
+	for (int i = 0; i < num_blobs; i++)
+		if (request_ids[i] >= 0) blobs[i]->shareDiff(diff_slots[planner.slot(request_ids[i])]);
+	return planner.requestedSize() - planner.plannedSize();
+}
+
+//	the last layer before layer_id writing blob_name, -1 if none
+static int findProducer(const vector<LayerParameter>& layer_params, const vector<bool>& removed,
+	const int layer_id, const string& blob_name){
+	for (int i = layer_id - 1; i >= 0; i--){
+		if (removed[i]) continue;
+		for (int top_id = 0; top_id < layer_params[i].top_size(); top_id++)
+			if (layer_params[i].top(top_id) == blob_name) return i;
+	}
+	return -1;
+}
+
+//	whether layer_id is the only reader of the single bottom it takes from producer_id
+//	a layer which is not in-place also hides it from the later layers after merging
+static bool onlyReader(const vector<LayerParameter>& layer_params, const vector<bool>& removed,
+	const int producer_id, const int layer_id){
+	const string& blob_name = layer_params[layer_id].bottom(0);
+	const bool in_place = layer_params[layer_id].top(0) == blob_name;
+	for (int i = producer_id + 1; i < layer_params.size(); i++){
+		if (i == layer_id || removed[i]) continue;
+		if (i > layer_id && in_place) break;
+		bool rewritten = false;
+		for (int bottom_id = 0; bottom_id < layer_params[i].bottom_size(); bottom_id++)
+			if (layer_params[i].bottom(bottom_id) == blob_name) return false;
+		for (int top_id = 0; top_id < layer_params[i].top_size(); top_id++)
+			if (layer_params[i].top(top_id) == blob_name) rewritten = true;
+		if (rewritten) break;
+	}
+	return true;
+}
+
+template <typename Dtype>
+bool Net<Dtype>::foldableLayer(const LayerParameter& layer_param){
+	if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1) return false;
+	if (layer_param.loss_weight_size() || layer_param.result_weight_size()) return false;
+	//	BatchNorm with the history stats and y=shift+scale*x are affine per channel
+	if (layer_param.type() == "BatchNorm") return layer_param.batch_norm_param().use_global_stats();
+	if (layer_param.type() == "Power") return layer_param.power_param().power() == 1;
+	return false;
+}
+
+template <typename Dtype>
+bool Net<Dtype>::foldTarget(const LayerParameter& layer_param){
+	if (layer_param.top_size() != 1 || layer_param.loss_weight_size()) return false;
+	//	an activation can not be folded through
+	if (layer_param.has_fused_relu()) return false;
+	//	shared weights would be rewritten for the other owners too
+	for (int i = 0; i < layer_param.param_size(); i++)
+		if (layer_param.param(i).name().size()) return false;
+	if (layer_param.type() == "Convolution") return true;
+	//	the folded channels must be the output axis
+	if (layer_param.type() == "InnerProduct") return layer_param.inner_product_param().axis() == 1;
+	return false;
+}
+
+template <typename Dtype>
+void Net<Dtype>::foldInference(const NetParameter& param, NetParameter* folded_param){
+	const int num_layers = param.layer_size();
+	vector<LayerParameter> layer_params(param.layer().begin(), param.layer().end());
+	vector<bool> folded(num_layers, false);
+	for (int layer_id = 0; layer_id < num_layers; layer_id++){
+		const LayerParameter& layer_param = layer_params[layer_id];
+		if (!foldableLayer(layer_param)) continue;
+		const bool in_place = layer_param.top(0) == layer_param.bottom(0);
+		const int producer_id = findProducer(layer_params, folded, layer_id, layer_param.bottom(0));
+		if (producer_id < 0 || !foldTarget(layer_params[producer_id])) continue;
+		//	nobody else can read the output of the producer before folding
+		if (!onlyReader(layer_params, folded, producer_id, layer_id)) continue;
+		LayerParameter& producer = layer_params[producer_id];
+		//	keep the blob names, the producer writes the top of the folded layer
+		if (!in_place) producer.set_top(0, layer_param.top(0));
+		//	folding needs a bias, which starts from zero
+		const bool is_conv = producer.type() == "Convolution";
+		const bool bias_term = is_conv ?
+			producer.convolution_param().bias_term() : producer.inner_product_param().bias_term();
+		if (!bias_term){
+			const int num_output = is_conv ?
+				producer.convolution_param().num_output() : producer.inner_product_param().num_output();
+			if (is_conv){
+				producer.mutable_convolution_param()->set_bias_term(true);
+				producer.mutable_convolution_param()->clear_bias_filler();
+			}
+			else{
+				producer.mutable_inner_product_param()->set_bias_term(true);
+				producer.mutable_inner_product_param()->clear_bias_filler();
+			}
+			if (producer.blobs_size() == 1){
+				BlobProto* bias = producer.add_blobs();
+				bias->mutable_shape()->add_dim(num_output);
+				for (int i = 0; i < num_output; i++) bias->add_data(0);
+			}
+		}
+		FoldedLayer folded_layer;
+		folded_layer.producer = producer.name();
+		folded_layer.param = layer_param;
+		folded_layer.param.clear_blobs();
+		folded_layer.in_place = in_place;
+		for (int i = 0; i < layer_param.blobs_size(); i++){
+			folded_layer.blobs.push_back(boost::shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+			folded_layer.blobs[i]->FromProto(layer_param.blobs(i));
+		}
+		folded_layer.loaded = layer_param.type() == "Power" || layer_param.blobs_size() > 0;
+		folded_layers.push_back(folded_layer);
+		folded[layer_id] = true;
+		LOG_IF(INFO, Dragon::get_root_solver())
+			<< "Fold Layer: " << layer_param.name() << " into " << producer.name();
+	}
+	folded_param->CopyFrom(param);
+	folded_param->clear_layer();
+	for (int layer_id = 0; layer_id < num_layers; layer_id++)
+		if (!folded[layer_id]) folded_param->add_layer()->CopyFrom(layer_params[layer_id]);
+}
+
+template <typename Dtype>
+void Net<Dtype>::fuseReLU(const NetParameter& param, NetParameter* fused_param){
+	const int num_layers = param.layer_size();
+	vector<LayerParameter> layer_params(param.layer().begin(), param.layer().end());
+	vector<bool> fused(num_layers, false);
+	for (int layer_id = 0; layer_id < num_layers; layer_id++){
+		const LayerParameter& layer_param = layer_params[layer_id];
+		if (layer_param.type() != "ReLU" || layer_param.bottom_size() != 1 || layer_param.top_size() != 1) continue;
+		if (layer_param.loss_weight_size() || layer_param.result_weight_size()) continue;
+		const int producer_id = findProducer(layer_params, fused, layer_id, layer_param.bottom(0));
+		if (producer_id < 0) continue;
+		LayerParameter& producer = layer_params[producer_id];
+		if (producer.type() != "Convolution" && producer.type() != "InnerProduct") continue;
+		//	every top of a multi-input Convolution would need its own ReLU
+		if (producer.top_size() != 1 || producer.has_fused_relu()) continue;
+		//	the pre-activations are gone after fusing
+		if (!onlyReader(layer_params, fused, producer_id, layer_id)) continue;
+		producer.set_top(0, layer_param.top(0));
+		producer.mutable_fused_relu()->CopyFrom(layer_param.relu_param());
+		fused[layer_id] = true;
+		LOG_IF(INFO, Dragon::get_root_solver())
+			<< "Fuse Layer: " << layer_param.name() << " into " << producer.name();
+	}
+	fused_param->CopyFrom(param);
+	fused_param->clear_layer();
+	for (int layer_id = 0; layer_id < num_layers; layer_id++)
+		if (!fused[layer_id]) fused_param->add_layer()->CopyFrom(layer_params[layer_id]);
+}
+
+template <typename Dtype>
+void Net<Dtype>::foldWeights(const set<string>& producers){
+	for (int i = 0; i < folded_layers.size(); i++){
+		const FoldedLayer& folded_layer = folded_layers[i];
+		if (!producers.count(folded_layer.producer)) continue;
+		CHECK(folded_layer.loaded)
+			<< "Layer: " << folded_layer.param.name() << " is folded before loading its params.";
+		const vector<boost::shared_ptr<Blob<Dtype> > >& target_blobs =
+			layers[layers_name_idx[folded_layer.producer]]->getBlobs();
+		CHECK_EQ(target_blobs.size(), 2);
+		const int num_output = target_blobs[1]->count();
+		const int dim = target_blobs[0]->count() / num_output;
+		Dtype* weight_data = target_blobs[0]->mutable_cpu_data();
+		Dtype* bias_data = target_blobs[1]->mutable_cpu_data();
+		const bool is_bn = folded_layer.param.type() == "BatchNorm";
+		if (is_bn){
+			CHECK_EQ(folded_layer.blobs.size(), 4);
+			for (int j = 0; j < 4; j++) CHECK_EQ(folded_layer.blobs[j]->count(), num_output)
+				<< "Layer: " << folded_layer.param.name() << " does not match the channels of its producer.";
+		}
+		//	y=a*(w*x+b)+c  =>  w'=a*w, b'=a*b+c
+		for (int c = 0; c < num_output; c++){
+			Dtype a, shift;
+			if (is_bn){
+				//	beta, gamma, history mean, history sqrt(var+eps)
+				const Dtype std = folded_layer.blobs[3]->cpu_data()[c];
+				CHECK_GT(std, 0) << "Layer: " << folded_layer.param.name() << " has no trained stats.";
+				a = folded_layer.blobs[1]->cpu_data()[c] / std;
+				shift = folded_layer.blobs[0]->cpu_data()[c] - folded_layer.blobs[2]->cpu_data()[c] * a;
+			}
+			else{
+				a = folded_layer.param.power_param().scale();
+				shift = folded_layer.param.power_param().shift();
+			}
+			for (int j = 0; j < dim; j++) weight_data[c*dim + j] *= a;
+			bias_data[c] = bias_data[c] * a + shift;
+		}
+	}
+}
+
+template <typename Dtype>
+bool Net<Dtype>::bottomShapesChanged(const int layer_id){
+	const vector<Blob<Dtype>*>& bottom = bottom_vecs[layer_id];
+	vector<int>& signature = bottom_shapes[layer_id];
+	int length = 1;
+	for (int i = 0; i < bottom.size(); i++) length += 1 + bottom[i]->num_axes();
+	bool changed = signature.size() != length || signature[0] != bottom.size();
+	for (int i = 0, j = 1; !changed && i < bottom.size(); i++){
+		const vector<int>& shape = bottom[i]->shape();
+		changed = signature[j++] != shape.size();
+		for (int k = 0; !changed && k < shape.size(); k++) changed = signature[j++] != shape[k];
+	}
+	if (!changed) return false;
+	//	rebuild only on a real change, the common case does not allocate
+	signature.resize(length);
+	signature[0] = bottom.size();
+	for (int i = 0, j = 1; i < bottom.size(); i++){
+		const vector<int>& shape = bottom[i]->shape();
+		signature[j++] = shape.size();
+		for (int k = 0; k < shape.size(); k++) signature[j++] = shape[k];
+	}
+	return true;
+}
+
 template <typename Dtype>
 ResultGroup Net<Dtype>::forwardWithResult(){
 	int start = 0, end = layers.size() - 1;
 	ResultGroup result_group;
+	bool reshaped = false;
 	for (int i = start; i <= end; i++){
-		layers[i]->forward(bottom_vecs[i], top_vecs[i]);
+		const bool changed = bottomShapesChanged(i);
+		reshaped |= changed;
+		layers[i]->forward(bottom_vecs[i], top_vecs[i], changed);
 		if (layers[i]->result_weights.size() > 0){
 			Result *rs = result_group.add_results();
 			*rs = layers[i]->result;
 		}
 	}
+	//	reshape may allocate diffs again
+	if (reshaped) releaseUnusedDiffs();
 	return result_group;
 
 }
@@ -451,10 +864,15 @@ Dtype Net<Dtype>::forwardFromTo(int start, int end){
 	CHECK_GE(start, 0);
 	CHECK_LT(end, layers.size());
 	Dtype tot_loss = 0;
+	bool reshaped = false;
 	for (int i = start; i <= end; i++){
-		Dtype layer_loss = layers[i]->forward(bottom_vecs[i], top_vecs[i]);
+		const bool changed = bottomShapesChanged(i);
+		reshaped |= changed;
+		Dtype layer_loss = layers[i]->forward(bottom_vecs[i], top_vecs[i], changed);
 		tot_loss += layer_loss;
 	}
+	//	reshape may allocate diffs again
+	if (reshaped) releaseUnusedDiffs();
 	return tot_loss;
 }
 
@@ -496,6 +914,7 @@ void Net<Dtype>::clearParamDiffs(){
 
 template <typename Dtype>
 void Net<Dtype>::shareTrainedLayerWith(const Net* other){
+	CHECK(folded_layers.empty()) << "Can not share the trained layers with a folded net.";
 	int num_source_layers = other->getLayers().size();
 	for (int i = 0; i < num_source_layers; i++){
 		Layer<Dtype>* source_layer = other->getLayers()[i].get();
@@ -527,9 +946,26 @@ void Net<Dtype>::shareTrainedLayerWith(const Net* other){
 template <typename Dtype>
 void Net<Dtype>::copyTrainedLayerFrom(const NetParameter& param){
 	int num_layers = param.layer_size();
+	//	producers of the folded layers, which need folding again
+	set<string> producers, folded_sources;
 	for (int i = 0; i < num_layers; i++){
 		const LayerParameter& source_layer = param.layer(i);
 		const string& source_layer_name = source_layer.name();
+		bool is_folded = false, is_producer = false;
+		for (int j = 0; j < folded_layers.size(); j++){
+			FoldedLayer& folded_layer = folded_layers[j];
+			is_producer |= folded_layer.producer == source_layer_name;
+			if (folded_layer.param.name() != source_layer_name) continue;
+			folded_layer.blobs.resize(source_layer.blobs_size());
+			for (int k = 0; k < source_layer.blobs_size(); k++){
+				folded_layer.blobs[k].reset(new Blob<Dtype>());
+				folded_layer.blobs[k]->FromProto(source_layer.blobs(k));
+			}
+			folded_layer.loaded = true;
+			folded_sources.insert(folded_layer.producer);
+			is_folded = true;
+		}
+		if (is_folded) continue;
 		int target_layer_id = 0;
 		while (target_layer_id != layer_names.size() &&
 			layer_names[target_layer_id] != source_layer_name){
@@ -537,7 +973,14 @@ void Net<Dtype>::copyTrainedLayerFrom(const NetParameter& param){
 		}
 		if (target_layer_id == layer_names.size()) continue;
 		const vector < boost::shared_ptr<Blob<Dtype>>>& target_blobs = layers[target_layer_id]->getBlobs();
-		for (int j = 0; j < target_blobs.size(); j++){
+		int num_blobs = target_blobs.size();
+		//	the bias added by folding is not in the model
+		if (is_producer && source_layer.blobs_size() == 1 && num_blobs == 2){
+			dragon_set(target_blobs[1]->count(), Dtype(0), target_blobs[1]->mutable_cpu_data());
+			num_blobs = 1;
+		}
+		if (is_producer) producers.insert(source_layer_name);
+		for (int j = 0; j < num_blobs; j++){
 			Blob<Dtype> source_blob;
 			source_blob.FromProto(source_layer.blobs(j));
 			Blob<Dtype>* target_blob = target_blobs[j].get();
@@ -546,6 +989,11 @@ void Net<Dtype>::copyTrainedLayerFrom(const NetParameter& param){
 			target_blob->FromProto(source_layer.blobs(j), false);
 		}
 	}
+	//	folding the new params into the old(folded) weights would be wrong
+	for (set<string>::iterator i = folded_sources.begin(); i != folded_sources.end(); i++)
+		CHECK(producers.count(*i)) << "The model updates the layers folded into: " << *i
+			<< " but not the layer itself, disable fold_inference for it.";
+	foldWeights(producers);
 }
 
 template <typename Dtype>
@@ -66,6 +66,12 @@ object blobReshape(boost::python::tuple args, dict kwargs){
 	return object();
 }
 
+//	numpy keeps the pointer, so the blob must not swap its memory away any more
+Dtype* blobData(Blob<Dtype>* self){
+	self->exposeData();
+	return self->mutable_cpu_data();
+}
+
 typedef vector<boost::shared_ptr<Blob<Dtype>>>  BlobVec;
 object addBlob(boost::python::tuple args, dict kwargs){
 	if (len(kwargs) > 0)
@@ -166,7 +172,7 @@ BOOST_PYTHON_MODULE(_dragon){
 		.add_property("count", static_cast<int (Blob<Dtype>::*)() const>(&Blob<Dtype>::count))
 		//	use python function
 		.def("reshape", raw_function(&blobReshape))
-		.add_property("data", make_function(&Blob<Dtype>::mutable_cpu_data, NdarrayCallPolicies()))
+		.add_property("data", make_function(&blobData, NdarrayCallPolicies()))
 		.add_property("diff", make_function(&Blob<Dtype>::mutable_cpu_diff, NdarrayCallPolicies()));
 
 	class_< Layer<Dtype>, boost::shared_ptr<PythonLayer<Dtype>>, boost::noncopyable>
@@ -155,6 +155,9 @@ void Solver<Dtype>::init(const SolverParameter& param){
 	//	set seed for random_generator if necessary
 	if (Dragon::get_root_solver() && param.random_seed() >= 0)
 		Dragon::set_random_seed(param.random_seed());
+	//	each solver thread owns its pool
+	if (param.num_threads() > 0) Dragon::set_num_threads(param.num_threads());
+	if (param.has_thread_affinity()) Dragon::set_thread_affinity(param.thread_affinity());
 	//	create and init a train net
 	initTrainNet();
 	if (Dragon::get_root_solver()){
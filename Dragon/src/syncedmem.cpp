@@ -3,7 +3,7 @@ void SyncedMemory::to_cpu()
 {
 	switch (head_){
 	case UNINITIALIZED:
-		dragonMalloc(&cpu_ptr, size_);
+		allocator = dragonMalloc(&cpu_ptr, size_);
 		dragonMemset(cpu_ptr, size_);
 		head_ = HEAD_AT_CPU;
 		own_cpu_data = true;
@@ -11,7 +11,7 @@ void SyncedMemory::to_cpu()
 	case HEAD_AT_GPU:
 #ifndef CPU_ONLY
 		if (cpu_ptr == NULL){
-			dragonMalloc(&cpu_ptr, size_);
+			allocator = dragonMalloc(&cpu_ptr, size_);
 			own_cpu_data = true;
 		}
 		dragonGpuMemcpy(cpu_ptr,gpu_ptr,size_);
@@ -60,10 +60,13 @@ const void* SyncedMemory::gpu_data(){
 }
 
 void SyncedMemory::set_cpu_data(void *data){
-	if (own_cpu_data) dragonFree(cpu_ptr);
+	CHECK(data);
+	CHECK(dragonIsAligned(data)) << "host data must be aligned to " << DRAGON_MALLOC_ALIGN << " bytes";
+	if (own_cpu_data) dragonFree(cpu_ptr, size_, allocator);
 	cpu_ptr = data;
 	head_ = HEAD_AT_CPU;
 	own_cpu_data = false;
+	version_++;
 }
 
 void SyncedMemory::set_gpu_data(void *data){
@@ -72,12 +75,14 @@ void SyncedMemory::set_gpu_data(void *data){
 	gpu_ptr = data;
 	head_ = HEAD_AT_GPU;
 	own_gpu_data = false;
+	version_++;
 #endif
 }
 
 void* SyncedMemory::mutable_cpu_data(){
 	to_cpu();
 	head_ = HEAD_AT_CPU;
+	version_++;
 	return cpu_ptr;
 }
 
@@ -85,6 +90,7 @@ void* SyncedMemory::mutable_gpu_data(){
 #ifndef CPU_ONLY
 	to_gpu();
 	head_ = HEAD_AT_GPU;
+	version_++;
 	return gpu_ptr;
 #endif
 }
@@ -104,7 +110,7 @@ void SyncedMemory::async_gpu_data(const cudaStream_t& stream){
 #endif
 
 SyncedMemory::~SyncedMemory(){
-	if (cpu_ptr && own_cpu_data) dragonFree(cpu_ptr);
+	if (cpu_ptr && own_cpu_data) dragonFree(cpu_ptr, size_, allocator);
 #ifndef CPU_ONLY
 	if (gpu_ptr && own_gpu_data) dragonGpuFree(gpu_ptr);
 #endif
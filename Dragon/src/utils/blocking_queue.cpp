@@ -73,3 +73,4 @@ template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
 template class BlockingQueue < Datum* > ;
 template class BlockingQueue < boost::shared_ptr<QueuePair> > ;
+template class BlockingQueue < int > ;
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "utils/datum_view.hpp"
+
+//	protobuf wire types used by Datum
+enum WireType{ WIRE_VARINT = 0, WIRE_FIXED64 = 1, WIRE_BYTES = 2, WIRE_FIXED32 = 5 };
+
+static uint64_t readVarint(const char*& ptr, const char* end){
+	uint64_t val = 0;
+	for (int shift = 0; shift < 64; shift += 7){
+		CHECK(ptr < end) << "Corrupted Datum: truncated varint.";
+		const uint8_t byte = (uint8_t)*ptr++;
+		val |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return val;
+	}
+	LOG(FATAL) << "Corrupted Datum: malformed varint.";
+	return 0;
+}
+
+void DatumView::reset(const char* buffer, const size_t size){
+	this->buffer = buffer;
+	this->size = size;
+	parsed = false;
+}
+
+void DatumView::swap(DatumView& other){
+	std::swap(*this, other);
+}
+
+void DatumView::parseHeader() const{
+	channels_ = height_ = width_ = label_ = float_count = 0;
+	encoded_ = false;
+	data_ = float_data_ = Bytes();
+	unpacked.clear();
+	const char* ptr = buffer;
+	const char* end = buffer + size;
+	while (ptr < end){
+		const uint64_t tag = readVarint(ptr, end);
+		const int field = (int)(tag >> 3), wire = (int)(tag & 7);
+		if (wire == WIRE_VARINT){
+			const int val = (int)readVarint(ptr, end);
+			switch (field){
+				case 1: channels_ = val; break;
+				case 2: height_ = val; break;
+				case 3: width_ = val; break;
+				case 4: label_ = val; break;
+				case 7: encoded_ = val != 0; break;
+				default: break;
+			}
+		}
+		else if (wire == WIRE_BYTES){
+			const uint64_t len = readVarint(ptr, end);
+			CHECK_LE(len, (uint64_t)(end - ptr)) << "Corrupted Datum: truncated field.";
+			if (field == 5){
+				data_.ptr = ptr;
+				data_.len = len;
+			}
+			//	packed float_data
+			else if (field == 6){
+				CHECK_EQ(len % sizeof(float), 0) << "Corrupted Datum: misaligned float_data.";
+				float_data_.ptr = ptr;
+				float_data_.len = len;
+			}
+			ptr += len;
+		}
+		else if (wire == WIRE_FIXED32){
+			CHECK_LE(4, end - ptr) << "Corrupted Datum: truncated field.";
+			//	float_data written one by one
+			if (field == 6){
+				float val;
+				memcpy(&val, ptr, sizeof(float));
+				unpacked.push_back(val);
+			}
+			ptr += 4;
+		}
+		else if (wire == WIRE_FIXED64){
+			CHECK_LE(8, end - ptr) << "Corrupted Datum: truncated field.";
+			ptr += 8;
+		}
+		else LOG(FATAL) << "Corrupted Datum: unsupported wire type " << wire << ".";
+	}
+	//	a mix of both encodings keeps the order of the fields
+	if (!unpacked.empty() && float_data_.len){
+		vector<float> packed(float_data_.len / sizeof(float));
+		memcpy(&packed[0], float_data_.ptr, float_data_.len);
+		unpacked.insert(unpacked.begin(), packed.begin(), packed.end());
+	}
+	float_count = unpacked.empty() ? (int)(float_data_.len / sizeof(float)) : (int)unpacked.size();
+	parsed = true;
+}
@@ -38,6 +38,12 @@ void LMDB::Open(const string& source, Mode mode){
 	LOG(INFO) << "Open lmdb file:" << source;
 }
 
+size_t LMDB::Count(){
+	MDB_stat stat;
+	MDB_CHECK(mdb_env_stat(mdb_env, &stat));
+	return stat.ms_entries;
+}
+
 LMDBCursor* LMDB::NewCursor(){
 	MDB_txn* txn;
 	MDB_cursor* cursor;
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include "utils/depthwise.hpp"
+#include "utils/math.hpp"
+#include "utils/im2col.hpp"
+
+template<typename Dtype>
+void depthwise_conv_cpu(const Dtype* im, const int channels, const int height, const int width,
+	const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const Dtype* weights, Dtype* out){
+	const int out_height = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+	const int out_width = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+	dragon_set(channels*multiplier*out_height*out_width, Dtype(0), out);
+	for (int c = 0; c < channels; c++){
+		const Dtype* map = im + c*height*width;
+		for (int k = 0; k < multiplier; k++){
+			const int oc = c*multiplier + k;
+			const Dtype* kernel = weights + oc*kernel_h*kernel_w;
+			Dtype* out_map = out + oc*out_height*out_width;
+			for (int kh = 0; kh < kernel_h; kh++){
+				for (int kw = 0; kw < kernel_w; kw++){
+					const Dtype w = kernel[kh*kernel_w + kw];
+					int lo, hi;
+					im2colRange(width, out_width, pad_w, stride_w, kw, lo, hi);
+					for (int h = 0; h < out_height; h++){
+						const int im_h = h*stride_h - pad_h + kh;
+						if (im_h < 0 || im_h >= height) continue;
+						const Dtype* src = map + im_h*width - pad_w + kw;
+						Dtype* dst = out_map + h*out_width;
+						if (stride_w == 1) for (int x = lo; x < hi; x++) dst[x] += w*src[x];
+						else for (int x = lo; x < hi; x++) dst[x] += w*src[x*stride_w];
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename Dtype>
+void depthwise_conv_backward_data_cpu(const Dtype* out_diff, const int channels, const int height, const int width,
+	const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const Dtype* weights, Dtype* im_diff){
+	const int out_height = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+	const int out_width = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+	dragon_set(channels*height*width, Dtype(0), im_diff);
+	for (int c = 0; c < channels; c++){
+		Dtype* map = im_diff + c*height*width;
+		for (int k = 0; k < multiplier; k++){
+			const int oc = c*multiplier + k;
+			const Dtype* kernel = weights + oc*kernel_h*kernel_w;
+			const Dtype* out_map = out_diff + oc*out_height*out_width;
+			for (int kh = 0; kh < kernel_h; kh++){
+				for (int kw = 0; kw < kernel_w; kw++){
+					const Dtype w = kernel[kh*kernel_w + kw];
+					int lo, hi;
+					im2colRange(width, out_width, pad_w, stride_w, kw, lo, hi);
+					for (int h = 0; h < out_height; h++){
+						const int im_h = h*stride_h - pad_h + kh;
+						if (im_h < 0 || im_h >= height) continue;
+						Dtype* dst = map + im_h*width - pad_w + kw;
+						const Dtype* src = out_map + h*out_width;
+						if (stride_w == 1) for (int x = lo; x < hi; x++) dst[x] += w*src[x];
+						else for (int x = lo; x < hi; x++) dst[x*stride_w] += w*src[x];
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename Dtype>
+void depthwise_conv_backward_weights_cpu(const Dtype* im, const Dtype* out_diff, const int channels,
+	const int height, const int width, const int multiplier, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* weights_diff){
+	const int out_height = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+	const int out_width = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+	for (int c = 0; c < channels; c++){
+		const Dtype* map = im + c*height*width;
+		for (int k = 0; k < multiplier; k++){
+			const int oc = c*multiplier + k;
+			Dtype* kernel_diff = weights_diff + oc*kernel_h*kernel_w;
+			const Dtype* out_map = out_diff + oc*out_height*out_width;
+			for (int kh = 0; kh < kernel_h; kh++){
+				for (int kw = 0; kw < kernel_w; kw++){
+					int lo, hi;
+					im2colRange(width, out_width, pad_w, stride_w, kw, lo, hi);
+					Dtype sum = 0;
+					for (int h = 0; h < out_height; h++){
+						const int im_h = h*stride_h - pad_h + kh;
+						if (im_h < 0 || im_h >= height) continue;
+						const Dtype* src = map + im_h*width - pad_w + kw;
+						const Dtype* diff = out_map + h*out_width;
+						if (stride_w == 1) for (int x = lo; x < hi; x++) sum += diff[x] * src[x];
+						else for (int x = lo; x < hi; x++) sum += diff[x] * src[x*stride_w];
+					}
+					kernel_diff[kh*kernel_w + kw] += sum;
+				}
+			}
+		}
+	}
+}
+
+template void depthwise_conv_cpu<float>(const float* im, const int channels, const int height, const int width,
+	const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const float* weights, float* out);
+template void depthwise_conv_cpu<double>(const double* im, const int channels, const int height, const int width,
+	const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const double* weights, double* out);
+template void depthwise_conv_backward_data_cpu<float>(const float* out_diff, const int channels, const int height,
+	const int width, const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const float* weights, float* im_diff);
+template void depthwise_conv_backward_data_cpu<double>(const double* out_diff, const int channels, const int height,
+	const int width, const int multiplier, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const double* weights, double* im_diff);
+template void depthwise_conv_backward_weights_cpu<float>(const float* im, const float* out_diff, const int channels,
+	const int height, const int width, const int multiplier, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, float* weights_diff);
+template void depthwise_conv_backward_weights_cpu<double>(const double* im, const double* out_diff, const int channels,
+	const int height, const int width, const int multiplier, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, double* weights_diff);
@@ -0,0 +1,85 @@
+#include "utils/epilogue.hpp"
+#include "utils/thread_pool.hpp"
+
+template <typename Dtype>
+static inline void biasReluRow(const int count, const Dtype* src, const Dtype b,
+	const bool relu, const Dtype slope, Dtype* dst, unsigned char* mask){
+	if (!relu){
+		for (int i = 0; i < count; i++) dst[i] = src[i] + b;
+		return;
+	}
+	if (mask){
+		for (int i = 0; i < count; i++){
+			const Dtype x = src[i] + b;
+			mask[i] = x > 0;
+			dst[i] = x > 0 ? x : x*slope;
+		}
+	}
+	else{
+		for (int i = 0; i < count; i++){
+			const Dtype x = src[i] + b;
+			dst[i] = x > 0 ? x : x*slope;
+		}
+	}
+}
+
+template <typename Dtype>
+void bias_relu_cpu(const int channels, const int spatial_dim, const Dtype* src, const int src_ld,
+	const Dtype* bias, const bool relu, const Dtype slope, Dtype* dst, unsigned char* mask){
+	dragon_parallel_for(0, channels, dragon_parallel_grain(spatial_dim), [&](int lo, int hi){
+		for (int c = lo; c < hi; c++){
+			const int offset = c*spatial_dim;
+			biasReluRow(spatial_dim, src + c*src_ld, bias ? bias[c] : Dtype(0), relu, slope,
+				dst + offset, mask ? mask + offset : NULL);
+		}
+	});
+}
+
+template <typename Dtype>
+void bias_relu_rows_cpu(const int rows, const int dim, const Dtype* bias,
+	const bool relu, const Dtype slope, Dtype* data, unsigned char* mask){
+	dragon_parallel_for(0, rows, dragon_parallel_grain(dim), [&](int lo, int hi){
+		for (int r = lo; r < hi; r++){
+			Dtype* row = data + r*dim;
+			unsigned char* row_mask = mask ? mask + r*dim : NULL;
+			if (!relu){
+				if (bias) for (int i = 0; i < dim; i++) row[i] += bias[i];
+				continue;
+			}
+			for (int i = 0; i < dim; i++){
+				const Dtype x = bias ? row[i] + bias[i] : row[i];
+				if (row_mask) row_mask[i] = x > 0;
+				row[i] = x > 0 ? x : x*slope;
+			}
+		}
+	});
+}
+
+template <typename Dtype>
+void relu_backward_cpu(const int count, const unsigned char* mask, const Dtype* data,
+	const Dtype slope, Dtype* diff){
+	CHECK(mask || slope >= 0) << "A negative slope needs the mask to recover the sign.";
+	dragon_parallel_for(0, count, dragon_parallel_grain(1), [&](int lo, int hi){
+		if (mask){
+			for (int i = lo; i < hi; i++) if (!mask[i]) diff[i] *= slope;
+		}
+		else{
+			for (int i = lo; i < hi; i++) if (!(data[i] > 0)) diff[i] *= slope;
+		}
+	});
+}
+
+template void bias_relu_cpu<float>(const int channels, const int spatial_dim, const float* src, const int src_ld,
+	const float* bias, const bool relu, const float slope, float* dst, unsigned char* mask);
+template void bias_relu_cpu<double>(const int channels, const int spatial_dim, const double* src, const int src_ld,
+	const double* bias, const bool relu, const double slope, double* dst, unsigned char* mask);
+
+template void bias_relu_rows_cpu<float>(const int rows, const int dim, const float* bias,
+	const bool relu, const float slope, float* data, unsigned char* mask);
+template void bias_relu_rows_cpu<double>(const int rows, const int dim, const double* bias,
+	const bool relu, const double slope, double* data, unsigned char* mask);
+
+template void relu_backward_cpu<float>(const int count, const unsigned char* mask, const float* data,
+	const float slope, float* diff);
+template void relu_backward_cpu<double>(const int count, const unsigned char* mask, const double* data,
+	const double slope, double* diff);
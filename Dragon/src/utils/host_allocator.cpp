@@ -0,0 +1,181 @@
+#include "utils/host_allocator.hpp"
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+//	never deleted, buffers may be freed during the static destruction
+static HostAllocator* host_allocator = new CachingHostAllocator();
+
+HostAllocator* HostAllocator::Get(){
+	return host_allocator;
+}
+
+void HostAllocator::Set(HostAllocator* allocator){
+	CHECK(allocator);
+	host_allocator = allocator;
+}
+
+void* dragonAlignedMalloc(size_t size){
+#ifdef _WIN32
+	return _aligned_malloc(size, DRAGON_MALLOC_ALIGN);
+#else
+	void* ptr = NULL;
+	if (posix_memalign(&ptr, DRAGON_MALLOC_ALIGN, size)) return NULL;
+	return ptr;
+#endif
+}
+
+void dragonAlignedFree(void* ptr){
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void* SystemHostAllocator::alloc(size_t size){
+	return dragonAlignedMalloc(size);
+}
+
+void SystemHostAllocator::dealloc(void* ptr, size_t size){
+	dragonAlignedFree(ptr);
+}
+
+//	index of the highest set bit
+static int highestBit(size_t val){
+	int pos = 0;
+	while (val >>= 1) pos++;
+	return pos;
+}
+
+int CachingHostAllocator::sizeToClass(size_t size){
+	if (size <= ((size_t)1 << MIN_CLASS_SHIFT)) return 0;
+	//	size in (2^e, 2^(e+1)] is split into 4 classes with a step of 2^(e-2)
+	const size_t val = size - 1;
+	const int e = highestBit(val);
+	if (e >= MAX_CLASS_SHIFT) return -1;
+	const int sub = (int)((val - ((size_t)1 << e)) >> (e - 2));
+	return 1 + (e - MIN_CLASS_SHIFT) * 4 + sub;
+}
+
+size_t CachingHostAllocator::classToSize(int idx){
+	if (idx == 0) return (size_t)1 << MIN_CLASS_SHIFT;
+	const int e = MIN_CLASS_SHIFT + (idx - 1) / 4;
+	const int sub = (idx - 1) % 4;
+	return ((size_t)1 << e) + ((size_t)(sub + 1) << (e - 2));
+}
+
+CachingHostAllocator::CachingHostAllocator(size_t cache_limit) :
+	magazines(&CachingHostAllocator::flushMagazine), cache_limit(cache_limit),
+	hits(0), misses(0), bytes_held(0), bytes_in_use(0) {}
+
+CachingHostAllocator::~CachingHostAllocator(){
+	magazines.reset();
+	release();
+}
+
+CachingHostAllocator::Magazine* CachingHostAllocator::magazine(){
+	if (!magazines.get()) magazines.reset(new Magazine(this));
+	return magazines.get();
+}
+
+void CachingHostAllocator::flushMagazine(Magazine* mag){
+	//	called when a thread exits, hand all cached blocks to other threads
+	for (int i = 0; i < NUM_CLASSES; i++) mag->allocator->flush(mag, i, 0);
+	delete mag;
+}
+
+void CachingHostAllocator::flush(Magazine* mag, int idx, size_t keep){
+	vector<void*>& blocks = mag->blocks[idx];
+	if (blocks.size() <= keep) return;
+	const size_t bytes = classToSize(idx);
+	Depot& depot = depots[idx];
+	boost::mutex::scoped_lock lock(depot.mutex);
+	while (blocks.size() > keep){
+		void* ptr = blocks.back();
+		blocks.pop_back();
+		//	over the limit, give it back to the system
+		if (cache_limit && bytes_held > cache_limit){
+			dragonAlignedFree(ptr);
+			bytes_held -= bytes;
+		}else depot.blocks.push_back(ptr);
+	}
+}
+
+void* CachingHostAllocator::alloc(size_t size){
+	const int idx = sizeToClass(size);
+	if (idx < 0){
+		misses++;
+		bytes_in_use += size;
+		return dragonAlignedMalloc(size);
+	}
+	const size_t bytes = classToSize(idx);
+	void* ptr = NULL;
+	//	fast path: the local magazine
+	vector<void*>& blocks = magazine()->blocks[idx];
+	if (!blocks.empty()){
+		ptr = blocks.back();
+		blocks.pop_back();
+	}else{
+		Depot& depot = depots[idx];
+		boost::mutex::scoped_lock lock(depot.mutex);
+		if (!depot.blocks.empty()){
+			ptr = depot.blocks.back();
+			depot.blocks.pop_back();
+		}
+	}
+	if (ptr){
+		hits++;
+		bytes_held -= bytes;
+	}else{
+		misses++;
+		ptr = dragonAlignedMalloc(bytes);
+		//	maybe the cache eats up the memory, drop it and retry
+		if (!ptr){
+			release();
+			ptr = dragonAlignedMalloc(bytes);
+		}
+		if (!ptr) return NULL;
+	}
+	bytes_in_use += bytes;
+	return ptr;
+}
+
+void CachingHostAllocator::dealloc(void* ptr, size_t size){
+	if (!ptr) return;
+	const int idx = sizeToClass(size);
+	if (idx < 0){
+		bytes_in_use -= size;
+		dragonAlignedFree(ptr);
+		return;
+	}
+	const size_t bytes = classToSize(idx);
+	bytes_in_use -= bytes;
+	bytes_held += bytes;
+	Magazine* mag = magazine();
+	mag->blocks[idx].push_back(ptr);
+	//	keep half of the magazine for the next allocations
+	if (mag->blocks[idx].size() > MAGAZINE_SIZE) flush(mag, idx, MAGAZINE_SIZE / 2);
+}
+
+void CachingHostAllocator::release(){
+	//	magazines of other threads are private, only drain the current thread's one
+	if (magazines.get())
+		for (int i = 0; i < NUM_CLASSES; i++) flush(magazines.get(), i, 0);
+	for (int i = 0; i < NUM_CLASSES; i++){
+		Depot& depot = depots[i];
+		boost::mutex::scoped_lock lock(depot.mutex);
+		for (int j = 0; j < depot.blocks.size(); j++) dragonAlignedFree(depot.blocks[j]);
+		bytes_held -= classToSize(i)*depot.blocks.size();
+		depot.blocks.clear();
+	}
+}
+
+HostAllocatorStats CachingHostAllocator::stats(){
+	HostAllocatorStats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.bytes_held = bytes_held;
+	stats.bytes_in_use = bytes_in_use;
+	return stats;
+}
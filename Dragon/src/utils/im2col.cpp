@@ -1,11 +1,14 @@
 #include <vector>
+#include <cstring>
 #include "utils/im2col.hpp"
 #include "utils/math.hpp"
+#include "utils/thread_pool.hpp"
 
 template<typename Dtype>
 void im2col_cpu(const Dtype* im, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* col){
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* col,
+	const int col_ld){
 	//	default using vaild convolution method
 	//	which drops invaild pixels by formula (length-kernel+stride)
 	//	condition_1(kernel>stride): named overlapping, formula drops the pixels at the end of row/col
@@ -21,48 +24,131 @@ void im2col_cpu(const Dtype* im, const int channels, const int height, const int
 	//	after yth computing, we will get y new pixels to combine a output map
 	//	and the x_th element's 0th computing will have a x units offset on the im (x units should be splited in w/h axis)
 	//	and we use padding for the im, the im_h and im_w will be out of range of im_shape
-	//	check it and using "0" but not the im's pixel
+	//	fill "0" for them but not the im's pixel
+	//	each row of a row-map is a strided span of an im row with zero margins
+	//	so we copy spans instead of checking every element
 	const int col_c = (channels*kernel_h*kernel_w);
-	for (int c = 0; c < col_c; c++){
-		int w_off = c % kernel_w;
-		int h_off = (c / kernel_w) % kernel_h;
-		int im_c = c / kernel_h / kernel_w;
-		for (int h = 0; h < col_h; h++){
-			for (int w = 0; w < col_w; w++){
+	const int ld = col_ld ? col_ld : col_h*col_w;
+	//	rows of the col are independent, split them across the pool
+	dragon_parallel_for(0, col_c, dragon_parallel_grain(col_h*col_w), [&](int c_begin, int c_end){
+		for (int c = c_begin; c < c_end; c++){
+			int w_off = c % kernel_w;
+			int h_off = (c / kernel_w) % kernel_h;
+			int im_c = c / kernel_h / kernel_w;
+			//	the valid span is the same for all rows of the row-map
+			int lo, hi;
+			im2colRange(width, col_w, pad_w, stride_w, w_off, lo, hi);
+			for (int h = 0; h < col_h; h++){
+				Dtype* dst = col + c*ld + h*col_w;
 				int im_h = h*stride_h - pad_h + h_off;
-				int im_w = w*stride_w - pad_w + w_off;
-				col[(c*col_h + h)*col_w + w] =
-					(im_h >= 0 && im_w >= 0 && im_h < height&&im_w < width) ?
-					im[(im_c*height + im_h)*width + im_w] : 0;
+				if (im_h < 0 || im_h >= height || lo >= hi){
+					memset(dst, 0, sizeof(Dtype)*col_w);
+					continue;
+				}
+				const Dtype* src = im + (im_c*height + im_h)*width - pad_w + w_off;
+				if (lo > 0) memset(dst, 0, sizeof(Dtype)*lo);
+				if (stride_w == 1) memcpy(dst + lo, src + lo, sizeof(Dtype)*(hi - lo));
+				else if (stride_w == 2) for (int w = lo; w < hi; w++) dst[w] = src[2 * w];
+				else for (int w = lo; w < hi; w++) dst[w] = src[w*stride_w];
+				if (hi < col_w) memset(dst + hi, 0, sizeof(Dtype)*(col_w - hi));
 			}
 		}
-	}
+	});
 }
 
 template<typename Dtype>
 void col2im_cpu(const Dtype* col, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* im){
-	dragon_set(channels*height*width, Dtype(0),im);
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* im,
+	const int col_ld){
 	const int col_h = (height + 2 * pad_h - kernel_h) / stride_h + 1;
 	const int col_w = (width + 2 * pad_w - kernel_w) / stride_w + 1;
-	const int col_c = (channels*kernel_h*kernel_w);
-	for (int c = 0; c < col_c; c++){
-		int w_off = c % kernel_w;
-		int h_off = (c / kernel_w) % kernel_h;
-		int im_c = c / kernel_h / kernel_w;
-		for (int h = 0; h < col_h; h++){
-			for (int w = 0; w < col_w; w++){
+	const int kernel_size = kernel_h*kernel_w;
+	const int ld = col_ld ? col_ld : col_h*col_w;
+	//	rows of a channel accumulate into the same im plane
+	//	so split the channels across the pool but not the rows
+	dragon_parallel_for(0, channels, dragon_parallel_grain(kernel_size*col_h*col_w), [&](int c_begin, int c_end){
+		dragon_set((c_end - c_begin)*height*width, Dtype(0), im + c_begin*height*width);
+		for (int c = c_begin*kernel_size; c < c_end*kernel_size; c++){
+			int w_off = c % kernel_w;
+			int h_off = (c / kernel_w) % kernel_h;
+			int im_c = c / kernel_h / kernel_w;
+			int lo, hi;
+			im2colRange(width, col_w, pad_w, stride_w, w_off, lo, hi);
+			for (int h = 0; h < col_h; h++){
 				int im_h = h*stride_h - pad_h + h_off;
-				int im_w = w*stride_w - pad_w + w_off;
+				if (im_h < 0 || im_h >= height) continue;
 				//	an im_pixel is cited by more col unit
 				//	we sum them to compute diff
-				if (im_h >= 0 && im_h < height&&im_w >= 0 && im_w < width){
-					im[(im_c*height + im_h)*width + im_w] += col[(c*col_h + h)*col_w + w];
-				}
+				const Dtype* src = col + c*ld + h*col_w;
+				Dtype* dst = im + (im_c*height + im_h)*width - pad_w + w_off;
+				if (stride_w == 1) for (int w = lo; w < hi; w++) dst[w] += src[w];
+				else if (stride_w == 2) for (int w = lo; w < hi; w++) dst[2 * w] += src[w];
+				else for (int w = lo; w < hi; w++) dst[w*stride_w] += src[w];
 			}
 		}
+	});
+}
+
+//	N-D version walks the output positions with an odometer
+//	im2col: im => col, otherwise col => im(accumulated)
+template<typename Dtype>
+static void im2col_nd_core_cpu(const Dtype* input, const bool im2col, const int num_spatial_axes,
+	const int* im_shape, const int* col_shape, const int* kernel_shape, const int* pad, const int* stride,
+	Dtype* output, const int col_ld){
+	if (!im2col){
+		int im_size = im_shape[0];
+		for (int i = 0; i < num_spatial_axes; i++) im_size *= im_shape[1 + i];
+		dragon_set(im_size, Dtype(0), output);
+	}
+	int kernel_size = 1, col_size = 1;
+	for (int i = 0; i < num_spatial_axes; i++){
+		kernel_size *= kernel_shape[i];
+		col_size *= col_shape[1 + i];
 	}
+	const int ld = col_ld ? col_ld : col_size;
+	const int channels_col = col_shape[0];
+	vector<int> d_offset(num_spatial_axes, 0);
+	vector<int> d_iter(num_spatial_axes, 0);
+	for (int c_col = 0; c_col < channels_col; c_col++){
+		//	the kernel offsets of this row
+		int offset = c_col;
+		for (int d_i = num_spatial_axes - 1; d_i >= 0; d_i--){
+			if (d_i < num_spatial_axes - 1) offset /= kernel_shape[d_i + 1];
+			d_offset[d_i] = offset % kernel_shape[d_i];
+		}
+		const int c_im = c_col / kernel_size;
+		for (int i = 0; i < col_size; i++){
+			//	i is the flattened d_iter
+			int index_im = c_im;
+			bool is_padding = false;
+			for (int d_i = 0; d_i < num_spatial_axes; d_i++){
+				const int d_im = d_iter[d_i] * stride[d_i] - pad[d_i] + d_offset[d_i];
+				is_padding |= d_im < 0 || d_im >= im_shape[d_i + 1];
+				index_im = index_im*im_shape[d_i + 1] + d_im;
+			}
+			const int index_col = c_col*ld + i;
+			if (im2col) output[index_col] = is_padding ? 0 : input[index_im];
+			else if (!is_padding) output[index_im] += input[index_col];
+			//	step the odometer
+			for (int d_i = num_spatial_axes - 1; d_i >= 0; d_i--){
+				if (++d_iter[d_i] < col_shape[d_i + 1]) break;
+				d_iter[d_i] = 0;
+			}
+		}
+	}
+}
+
+template<typename Dtype>
+void im2col_nd_cpu(const Dtype* im, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, Dtype* col, const int col_ld){
+	im2col_nd_core_cpu(im, true, num_spatial_axes, im_shape, col_shape, kernel_shape, pad, stride, col, col_ld);
+}
+
+template<typename Dtype>
+void col2im_nd_cpu(const Dtype* col, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, Dtype* im, const int col_ld){
+	im2col_nd_core_cpu(col, false, num_spatial_axes, im_shape, col_shape, kernel_shape, pad, stride, im, col_ld);
 }
 
 
@@ -71,18 +157,32 @@ void col2im_cpu(const Dtype* col, const int channels, const int height, const in
 
 template void im2col_cpu<float>(const float* im, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, float* col);
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, float* col,
+	const int col_ld);
 
 template void im2col_cpu<double>(const double* im, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, double* col);
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, double* col,
+	const int col_ld);
 
 template void col2im_cpu<float>(const float* col, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, float* im);
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, float* im,
+	const int col_ld);
 
 template void col2im_cpu<double>(const double* col, const int channels, const int height, const int width,
 	const int kernel_h, const int kernel_w,
-	const int pad_h, const int pad_w, const int stride_h, const int stride_w, double* im);
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, double* im,
+	const int col_ld);
+
+template void im2col_nd_cpu<float>(const float* im, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, float* col, const int col_ld);
+
+template void im2col_nd_cpu<double>(const double* im, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, double* col, const int col_ld);
 
+template void col2im_nd_cpu<float>(const float* col, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, float* im, const int col_ld);
 
+template void col2im_nd_cpu<double>(const double* col, const int num_spatial_axes, const int* im_shape, const int* col_shape,
+	const int* kernel_shape, const int* pad, const int* stride, double* im, const int col_ld);
@@ -2,6 +2,7 @@
 #include "utils/math.hpp"
 #include "utils/mkl_alternative.hpp"
 #include "common.hpp"
+#include "utils/thread_pool.hpp"
 
 template<typename Dtype>
 void dragon_copy(const int N, Dtype *dest, const Dtype *src){
@@ -53,6 +54,23 @@ void dragon_cpu_gemm<double>(const CBLAS_TRANSPOSE transA, const CBLAS_TRANSPOSE
 	cblas_dgemm(CblasRowMajor, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, N);
 }
 
+template<typename Dtype>
+void dragon_cpu_gemm_strided_batched(const CBLAS_TRANSPOSE transA, const CBLAS_TRANSPOSE transB,
+	const int M, const int N, const int K, const Dtype alpha, const Dtype* A, const int stride_a,
+	const Dtype* B, const int stride_b, const Dtype beta, Dtype *C, const int stride_c, const int batch_count){
+	//	cblas has no batched interface, loop here instead of in every caller
+	for (int i = 0; i < batch_count; i++)
+		dragon_cpu_gemm<Dtype>(transA, transB, M, N, K, alpha, A + (size_t)i*stride_a, B + (size_t)i*stride_b,
+			beta, C + (size_t)i*stride_c);
+}
+
+template void dragon_cpu_gemm_strided_batched<float>(const CBLAS_TRANSPOSE transA, const CBLAS_TRANSPOSE transB,
+	const int M, const int N, const int K, const float alpha, const float* A, const int stride_a,
+	const float* B, const int stride_b, const float beta, float *C, const int stride_c, const int batch_count);
+template void dragon_cpu_gemm_strided_batched<double>(const CBLAS_TRANSPOSE transA, const CBLAS_TRANSPOSE transB,
+	const int M, const int N, const int K, const double alpha, const double* A, const int stride_a,
+	const double* B, const int stride_b, const double beta, double *C, const int stride_c, const int batch_count);
+
 template<>
 void dragon_cpu_gemv<float>(const CBLAS_TRANSPOSE transA, const int M, const int N, const float alpha,
 	const float* A, const float* x, const float beta, float* y){
@@ -111,6 +129,36 @@ void dragon_rng_bernoulli(const int N, const Dtype p, unsigned int* x){
 template void dragon_rng_bernoulli<float>(const int N, const float p, unsigned int* x);
 template void dragon_rng_bernoulli<double>(const int N, const double p, unsigned int* x);
 
+template<typename Dtype>
+void dragon_rng_bernoulli_bits(const int N, const Dtype p, unsigned int* bits){
+	CHECK_GT(N, 0);
+	CHECK(bits);
+	CHECK_GE(p, 0);
+	CHECK_LE(p, 1);
+	//	a fresh key per call, the counter of a word is its index
+	const uint64_t key = ((uint64_t)Dragon::get_random_value() << 32) | Dragon::get_random_value();
+	//	r < p*2^32 holds with probability p, p=1 keeps every bit
+	const uint64_t threshold = (uint64_t)((double)p * 4294967296.0);
+	const int num_words = (N + 31) / 32;
+	//	a word takes 32 numbers, exactly the PHILOX_LANES blocks of a call
+	dragon_parallel_for(0, num_words, dragon_parallel_grain(32 * 16), [&](int lo, int hi){
+		uint32_t r[4][PHILOX_LANES];
+		for (int w = lo; w < hi; w++){
+			philox4x32((uint64_t)w*PHILOX_LANES, key, r);
+			unsigned int word = 0;
+			for (int j = 0; j < 4; j++)
+				for (int l = 0; l < PHILOX_LANES; l++)
+					word |= (unsigned int)(r[j][l] < threshold) << (j*PHILOX_LANES + l);
+			bits[w] = word;
+		}
+	});
+	//	clear the bits after N
+	if (N % 32) bits[num_words - 1] &= (1u << (N % 32)) - 1;
+}
+
+template void dragon_rng_bernoulli_bits<float>(const int N, const float p, unsigned int* bits);
+template void dragon_rng_bernoulli_bits<double>(const int N, const double p, unsigned int* bits);
+
 
 template<> void dragon_axpy<float>(int N,float alpha,const float *x,float *y){
 	cblas_saxpy(N, alpha, x, 1, y, 1);
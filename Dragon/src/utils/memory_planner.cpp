@@ -0,0 +1,77 @@
+#include <algorithm>
+#include "utils/memory_planner.hpp"
+#include "common.hpp"
+
+int MemoryPlanner::add(int first, int last, size_t size){
+	CHECK_LE(first, last);
+	Request request;
+	request.first = first;
+	request.last = last;
+	request.size = size;
+	requests.push_back(request);
+	slots.push_back(-1);
+	return requests.size() - 1;
+}
+
+bool MemoryPlanner::overlap(int slot_id, const Request& request) const{
+	const vector<int>& owners = slot_requests[slot_id];
+	for (int i = 0; i < owners.size(); i++){
+		const Request& other = requests[owners[i]];
+		if (request.first <= other.last && other.first <= request.last) return true;
+	}
+	return false;
+}
+
+//	sort request ids by size in descending order
+struct RequestSizeGreater{
+	RequestSizeGreater(const vector<size_t>& sizes) :sizes(sizes) {}
+	bool operator()(int a, int b) const{
+		if (sizes[a] != sizes[b]) return sizes[a] > sizes[b];
+		return a < b;
+	}
+	const vector<size_t>& sizes;
+};
+
+void MemoryPlanner::plan(){
+	slot_sizes.clear();
+	slot_requests.clear();
+	vector<int> order(requests.size());
+	vector<size_t> sizes(requests.size());
+	for (int i = 0; i < requests.size(); i++){
+		order[i] = i;
+		sizes[i] = requests[i].size;
+	}
+	std::sort(order.begin(), order.end(), RequestSizeGreater(sizes));
+	for (int i = 0; i < order.size(); i++){
+		const int request_id = order[i];
+		const Request& request = requests[request_id];
+		//	slots are created in descending order of size
+		//	so all existing slots can hold it, pick the smallest one
+		int best = -1;
+		for (int j = slot_sizes.size() - 1; j >= 0; j--){
+			if (!overlap(j, request)){
+				best = j;
+				break;
+			}
+		}
+		if (best < 0){
+			best = slot_sizes.size();
+			slot_sizes.push_back(request.size);
+			slot_requests.push_back(vector<int>());
+		}
+		slots[request_id] = best;
+		slot_requests[best].push_back(request_id);
+	}
+}
+
+size_t MemoryPlanner::requestedSize() const{
+	size_t size = 0;
+	for (int i = 0; i < requests.size(); i++) size += requests[i].size;
+	return size;
+}
+
+size_t MemoryPlanner::plannedSize() const{
+	size_t size = 0;
+	for (int i = 0; i < slot_sizes.size(); i++) size += slot_sizes[i];
+	return size;
+}
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include "utils/pooling.hpp"
+#include "utils/math.hpp"
+
+using std::min;
+using std::max;
+
+PoolingKernel select_pooling_kernel(const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const bool global_pooling){
+	if (global_pooling && pad_h == 0 && pad_w == 0) return POOLING_GLOBAL;
+	if (kernel_h != kernel_w || stride_h != stride_w) return POOLING_GENERIC;
+	if (kernel_h == 2 && stride_h == 2) return POOLING_2X2_S2;
+	if (kernel_h == 3 && stride_h == 2) return POOLING_3X3_S2;
+	if (kernel_h == 3 && stride_h == 1) return POOLING_3X3_S1;
+	return POOLING_GENERIC;
+}
+
+//	geometry of a plane, saves passing a dozen ints to every helper
+struct PoolingGeometry{
+	int height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, pooled_h, pooled_w;
+	//	outputs in [lo, hi) have their whole window inside the image
+	void interior(const int length, const int kernel, const int pad, const int stride, const int pooled,
+		int& lo, int& hi) const{
+		lo = min((pad + stride - 1) / stride, pooled);
+		hi = length + pad - kernel >= 0 ? min((length + pad - kernel) / stride + 1, pooled) : 0;
+		hi = max(hi, lo);
+	}
+};
+
+template<typename Dtype>
+static inline Dtype maxWindow(const Dtype* in, const PoolingGeometry& g, const int ph, const int pw,
+	unsigned char& k){
+	const int h0 = ph*g.stride_h - g.pad_h, w0 = pw*g.stride_w - g.pad_w;
+	const int start_h = max(h0, 0), start_w = max(w0, 0);
+	const int end_h = min(h0 + g.kernel_h, g.height), end_w = min(w0 + g.kernel_w, g.width);
+	//	the first max wins as the original scan
+	Dtype max_val = in[start_h*g.width + start_w];
+	k = (start_h - h0)*g.kernel_w + start_w - w0;
+	for (int h = start_h; h < end_h; h++){
+		for (int w = start_w; w < end_w; w++){
+			if (in[h*g.width + w] > max_val){
+				max_val = in[h*g.width + w];
+				k = (h - h0)*g.kernel_w + w - w0;
+			}
+		}
+	}
+	return max_val;
+}
+
+template<typename Dtype>
+static inline Dtype avgWindow(const Dtype* in, const PoolingGeometry& g, const int ph, const int pw){
+	const int h0 = ph*g.stride_h - g.pad_h, w0 = pw*g.stride_w - g.pad_w;
+	const int pool_area = (min(h0 + g.kernel_h, g.height + g.pad_h) - h0)*(min(w0 + g.kernel_w, g.width + g.pad_w) - w0);
+	const int start_h = max(h0, 0), start_w = max(w0, 0);
+	const int end_h = min(h0 + g.kernel_h, g.height), end_w = min(w0 + g.kernel_w, g.width);
+	Dtype sum = 0;
+	for (int h = start_h; h < end_h; h++)
+		for (int w = start_w; w < end_w; w++) sum += in[h*g.width + w];
+	return sum / pool_area;
+}
+
+template<typename Dtype>
+static inline void avgWindowBackward(const Dtype diff, const PoolingGeometry& g, const int ph, const int pw,
+	Dtype* in_diff){
+	const int h0 = ph*g.stride_h - g.pad_h, w0 = pw*g.stride_w - g.pad_w;
+	const int pool_area = (min(h0 + g.kernel_h, g.height + g.pad_h) - h0)*(min(w0 + g.kernel_w, g.width + g.pad_w) - w0);
+	const int start_h = max(h0, 0), start_w = max(w0, 0);
+	const int end_h = min(h0 + g.kernel_h, g.height), end_w = min(w0 + g.kernel_w, g.width);
+	const Dtype val = diff / pool_area;
+	for (int h = start_h; h < end_h; h++)
+		for (int w = start_w; w < end_w; w++) in_diff[h*g.width + w] += val;
+}
+
+//	K/S = 0 means the generic window
+template<typename Dtype, int K, int S>
+static void maxPoolPlane(const Dtype* in, const PoolingGeometry& g, Dtype* out, unsigned char* mask){
+	int h_lo = 0, h_hi = 0, w_lo = 0, w_hi = 0;
+	if (K){
+		g.interior(g.height, K, g.pad_h, S, g.pooled_h, h_lo, h_hi);
+		g.interior(g.width, K, g.pad_w, S, g.pooled_w, w_lo, w_hi);
+	}
+	for (int ph = 0; ph < g.pooled_h; ph++){
+		Dtype* out_row = out + ph*g.pooled_w;
+		unsigned char* mask_row = mask + ph*g.pooled_w;
+		const bool interior_row = ph >= h_lo && ph < h_hi;
+		for (int pw = 0; pw < g.pooled_w; pw++){
+			if (interior_row && pw == w_lo) pw = w_hi;
+			if (pw < g.pooled_w) out_row[pw] = maxWindow(in, g, ph, pw, mask_row[pw]);
+		}
+		if (!interior_row || w_lo >= w_hi) continue;
+		//	keep the running max of the row and update it with a kernel element at a time
+		const Dtype* base = in + (ph*S - g.pad_h)*g.width - g.pad_w;
+		for (int pw = w_lo; pw < w_hi; pw++){
+			out_row[pw] = base[pw*S];
+			mask_row[pw] = 0;
+		}
+		for (int i = 0; i < K; i++){
+			for (int j = 0; j < K; j++){
+				if (i == 0 && j == 0) continue;
+				const Dtype* src = base + i*g.width + j;
+				const unsigned char k = i*K + j;
+				for (int pw = w_lo; pw < w_hi; pw++){
+					const Dtype val = src[pw*S];
+					const bool greater = val > out_row[pw];
+					out_row[pw] = greater ? val : out_row[pw];
+					mask_row[pw] = greater ? k : mask_row[pw];
+				}
+			}
+		}
+	}
+}
+
+template<typename Dtype, int K, int S>
+static void avgPoolPlane(const Dtype* in, const PoolingGeometry& g, Dtype* out){
+	int h_lo = 0, h_hi = 0, w_lo = 0, w_hi = 0;
+	if (K){
+		g.interior(g.height, K, g.pad_h, S, g.pooled_h, h_lo, h_hi);
+		g.interior(g.width, K, g.pad_w, S, g.pooled_w, w_lo, w_hi);
+	}
+	for (int ph = 0; ph < g.pooled_h; ph++){
+		Dtype* out_row = out + ph*g.pooled_w;
+		const bool interior_row = ph >= h_lo && ph < h_hi;
+		for (int pw = 0; pw < g.pooled_w; pw++){
+			if (interior_row && pw == w_lo) pw = w_hi;
+			if (pw < g.pooled_w) out_row[pw] = avgWindow(in, g, ph, pw);
+		}
+		if (!interior_row || w_lo >= w_hi) continue;
+		//	same summing order as the generic window
+		const Dtype* base = in + (ph*S - g.pad_h)*g.width - g.pad_w;
+		for (int pw = w_lo; pw < w_hi; pw++) out_row[pw] = 0;
+		for (int i = 0; i < K; i++){
+			for (int j = 0; j < K; j++){
+				const Dtype* src = base + i*g.width + j;
+				for (int pw = w_lo; pw < w_hi; pw++) out_row[pw] += src[pw*S];
+			}
+		}
+		for (int pw = w_lo; pw < w_hi; pw++) out_row[pw] /= Dtype(K*K);
+	}
+}
+
+//	KW = 0 means kernel_w is not known at compile time
+template<typename Dtype, int KW>
+static void maxPoolBackwardPlane(const Dtype* out_diff, const unsigned char* mask, const PoolingGeometry& g,
+	Dtype* in_diff){
+	const int kernel_w = KW ? KW : g.kernel_w;
+	for (int ph = 0; ph < g.pooled_h; ph++){
+		const int h0 = ph*g.stride_h - g.pad_h;
+		for (int pw = 0; pw < g.pooled_w; pw++){
+			const int idx = ph*g.pooled_w + pw;
+			const int k = mask[idx];
+			in_diff[(h0 + k / kernel_w)*g.width + pw*g.stride_w - g.pad_w + k % kernel_w] += out_diff[idx];
+		}
+	}
+}
+
+template<typename Dtype, int K, int S>
+static void avgPoolBackwardPlane(const Dtype* out_diff, const PoolingGeometry& g, Dtype* in_diff){
+	int h_lo = 0, h_hi = 0, w_lo = 0, w_hi = 0;
+	if (K){
+		g.interior(g.height, K, g.pad_h, S, g.pooled_h, h_lo, h_hi);
+		g.interior(g.width, K, g.pad_w, S, g.pooled_w, w_lo, w_hi);
+	}
+	for (int ph = 0; ph < g.pooled_h; ph++){
+		const Dtype* diff_row = out_diff + ph*g.pooled_w;
+		const bool interior_row = ph >= h_lo && ph < h_hi;
+		for (int pw = 0; pw < g.pooled_w; pw++){
+			if (interior_row && pw == w_lo) pw = w_hi;
+			if (pw < g.pooled_w) avgWindowBackward(diff_row[pw], g, ph, pw, in_diff);
+		}
+		if (!interior_row || w_lo >= w_hi) continue;
+		//	the targets of a kernel element are distinct along the row, no conflicts
+		Dtype* base = in_diff + (ph*S - g.pad_h)*g.width - g.pad_w;
+		for (int i = 0; i < K; i++){
+			for (int j = 0; j < K; j++){
+				Dtype* dst = base + i*g.width + j;
+				for (int pw = w_lo; pw < w_hi; pw++) dst[pw*S] += diff_row[pw] / Dtype(K*K);
+			}
+		}
+	}
+}
+
+static PoolingGeometry makeGeometry(const int height, const int width, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w, const int pooled_h, const int pooled_w){
+	PoolingGeometry g;
+	g.height = height; g.width = width;
+	g.kernel_h = kernel_h; g.kernel_w = kernel_w;
+	g.pad_h = pad_h; g.pad_w = pad_w;
+	g.stride_h = stride_h; g.stride_w = stride_w;
+	g.pooled_h = pooled_h; g.pooled_w = pooled_w;
+	return g;
+}
+
+template<typename Dtype>
+void max_pool_cpu(const PoolingKernel kernel, const Dtype* in, const int num_planes, const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* out, unsigned char* mask){
+	CHECK_LE(kernel_h*kernel_w, POOLING_MAX_MASK_WINDOW) << "window is too large for the compact mask.";
+	const PoolingGeometry g = makeGeometry(height, width, kernel_h, kernel_w, pad_h, pad_w,
+		stride_h, stride_w, pooled_h, pooled_w);
+	const int in_dim = height*width, out_dim = pooled_h*pooled_w;
+	for (int n = 0; n < num_planes; n++){
+		const Dtype* plane = in + n*in_dim;
+		Dtype* out_plane = out + n*out_dim;
+		unsigned char* mask_plane = mask + n*out_dim;
+		switch (kernel){
+		case POOLING_2X2_S2: maxPoolPlane<Dtype, 2, 2>(plane, g, out_plane, mask_plane); break;
+		case POOLING_3X3_S2: maxPoolPlane<Dtype, 3, 2>(plane, g, out_plane, mask_plane); break;
+		case POOLING_3X3_S1: maxPoolPlane<Dtype, 3, 1>(plane, g, out_plane, mask_plane); break;
+		case POOLING_GLOBAL:{
+			//	a plain reduction, the window index is the plane index
+			Dtype max_val = plane[0];
+			int k = 0;
+			for (int i = 1; i < in_dim; i++){
+				if (plane[i] > max_val){
+					max_val = plane[i];
+					k = i;
+				}
+			}
+			out_plane[0] = max_val;
+			mask_plane[0] = k;
+			break;
+		}
+		default: maxPoolPlane<Dtype, 0, 0>(plane, g, out_plane, mask_plane);
+		}
+	}
+}
+
+template<typename Dtype>
+void avg_pool_cpu(const PoolingKernel kernel, const Dtype* in, const int num_planes, const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* out){
+	const PoolingGeometry g = makeGeometry(height, width, kernel_h, kernel_w, pad_h, pad_w,
+		stride_h, stride_w, pooled_h, pooled_w);
+	const int in_dim = height*width, out_dim = pooled_h*pooled_w;
+	for (int n = 0; n < num_planes; n++){
+		const Dtype* plane = in + n*in_dim;
+		Dtype* out_plane = out + n*out_dim;
+		switch (kernel){
+		case POOLING_2X2_S2: avgPoolPlane<Dtype, 2, 2>(plane, g, out_plane); break;
+		case POOLING_3X3_S2: avgPoolPlane<Dtype, 3, 2>(plane, g, out_plane); break;
+		case POOLING_3X3_S1: avgPoolPlane<Dtype, 3, 1>(plane, g, out_plane); break;
+		case POOLING_GLOBAL:{
+			Dtype sum = 0;
+			for (int i = 0; i < in_dim; i++) sum += plane[i];
+			out_plane[0] = sum / in_dim;
+			break;
+		}
+		default: avgPoolPlane<Dtype, 0, 0>(plane, g, out_plane);
+		}
+	}
+}
+
+template<typename Dtype>
+void max_pool_backward_cpu(const PoolingKernel kernel, const Dtype* out_diff, const unsigned char* mask,
+	const int num_planes, const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* in_diff){
+	const PoolingGeometry g = makeGeometry(height, width, kernel_h, kernel_w, pad_h, pad_w,
+		stride_h, stride_w, pooled_h, pooled_w);
+	const int in_dim = height*width, out_dim = pooled_h*pooled_w;
+	for (int n = 0; n < num_planes; n++){
+		const Dtype* diff_plane = out_diff + n*out_dim;
+		const unsigned char* mask_plane = mask + n*out_dim;
+		Dtype* plane = in_diff + n*in_dim;
+		switch (kernel){
+		case POOLING_2X2_S2: maxPoolBackwardPlane<Dtype, 2>(diff_plane, mask_plane, g, plane); break;
+		case POOLING_3X3_S2:
+		case POOLING_3X3_S1: maxPoolBackwardPlane<Dtype, 3>(diff_plane, mask_plane, g, plane); break;
+		case POOLING_GLOBAL: plane[mask_plane[0]] += diff_plane[0]; break;
+		default: maxPoolBackwardPlane<Dtype, 0>(diff_plane, mask_plane, g, plane);
+		}
+	}
+}
+
+template<typename Dtype>
+void avg_pool_backward_cpu(const PoolingKernel kernel, const Dtype* out_diff, const int num_planes,
+	const int height, const int width,
+	const int kernel_h, const int kernel_w, const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, Dtype* in_diff){
+	const PoolingGeometry g = makeGeometry(height, width, kernel_h, kernel_w, pad_h, pad_w,
+		stride_h, stride_w, pooled_h, pooled_w);
+	const int in_dim = height*width, out_dim = pooled_h*pooled_w;
+	for (int n = 0; n < num_planes; n++){
+		const Dtype* diff_plane = out_diff + n*out_dim;
+		Dtype* plane = in_diff + n*in_dim;
+		switch (kernel){
+		case POOLING_2X2_S2: avgPoolBackwardPlane<Dtype, 2, 2>(diff_plane, g, plane); break;
+		case POOLING_3X3_S2: avgPoolBackwardPlane<Dtype, 3, 2>(diff_plane, g, plane); break;
+		case POOLING_3X3_S1: avgPoolBackwardPlane<Dtype, 3, 1>(diff_plane, g, plane); break;
+		case POOLING_GLOBAL:{
+			const Dtype val = diff_plane[0] / in_dim;
+			for (int i = 0; i < in_dim; i++) plane[i] += val;
+			break;
+		}
+		default: avgPoolBackwardPlane<Dtype, 0, 0>(diff_plane, g, plane);
+		}
+	}
+}
+
+//	explicit instantiation for function
+
+template void max_pool_cpu<float>(const PoolingKernel kernel, const float* in, const int num_planes,
+	const int height, const int width, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const int pooled_h, const int pooled_w, float* out, unsigned char* mask);
+template void max_pool_cpu<double>(const PoolingKernel kernel, const double* in, const int num_planes,
+	const int height, const int width, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const int pooled_h, const int pooled_w, double* out, unsigned char* mask);
+
+template void avg_pool_cpu<float>(const PoolingKernel kernel, const float* in, const int num_planes,
+	const int height, const int width, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const int pooled_h, const int pooled_w, float* out);
+template void avg_pool_cpu<double>(const PoolingKernel kernel, const double* in, const int num_planes,
+	const int height, const int width, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+	const int stride_h, const int stride_w, const int pooled_h, const int pooled_w, double* out);
+
+template void max_pool_backward_cpu<float>(const PoolingKernel kernel, const float* out_diff, const unsigned char* mask,
+	const int num_planes, const int height, const int width, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, float* in_diff);
+template void max_pool_backward_cpu<double>(const PoolingKernel kernel, const double* out_diff, const unsigned char* mask,
+	const int num_planes, const int height, const int width, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, double* in_diff);
+
+template void avg_pool_backward_cpu<float>(const PoolingKernel kernel, const float* out_diff, const int num_planes,
+	const int height, const int width, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, float* in_diff);
+template void avg_pool_backward_cpu<double>(const PoolingKernel kernel, const double* out_diff, const int num_planes,
+	const int height, const int width, const int kernel_h, const int kernel_w,
+	const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pooled_h, const int pooled_w, double* in_diff);
@@ -0,0 +1,149 @@
+#include <boost/bind.hpp>
+#include "utils/thread_pool.hpp"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//	the pool which the current thread is working for
+//	nothing to delete, the pointer only marks the thread
+static void noCleanup(ThreadPool* pool) {}
+static boost::thread_specific_ptr<ThreadPool> current_pool(&noCleanup);
+
+//	the next free core for a binding pool, shared by the pools of all threads
+static boost::atomic<int> next_core(0);
+
+static void bindCore(int core){
+	const int num_cores = max(1, (int)boost::thread::hardware_concurrency());
+	core %= num_cores;
+#ifdef _WIN32
+	if (core < 8 * (int)sizeof(DWORD_PTR))
+		SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core);
+#elif defined(__linux__)
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core, &cpu_set);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+#endif
+}
+
+ThreadPool::ThreadPool(int num_threads, bool bind_cores) :
+	num_workers(max(num_threads, 1) - 1), bind_cores(bind_cores), core_base(0), ranges(NULL), num_ranges(0),
+	job(NULL), grain(1), generation(0), slots(0), pending(0), stop(false){
+	if (bind_cores) core_base = next_core.fetch_add(num_workers);
+	ranges = new Range[size()];
+	for (int i = 0; i < size(); i++){
+		ranges[i].next = 0;
+		ranges[i].end = 0;
+	}
+	for (int i = 0; i < num_workers; i++)
+		workers.create_thread(boost::bind(&ThreadPool::workerLoop, this, i + 1));
+}
+
+ThreadPool::~ThreadPool(){
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		stop = true;
+		job_cond.notify_all();
+	}
+	workers.join_all();
+	delete[] ranges;
+}
+
+bool ThreadPool::inParallel(){
+	return current_pool.get() != NULL;
+}
+
+void ThreadPool::workerLoop(int id){
+	current_pool.reset(this);
+	if (bind_cores) bindCore(core_base + id);
+	unsigned int seen = 0;
+	while (true){
+		//	a short spin catches the back-to-back regions of a layer
+		for (int i = 0; i < SPIN_COUNT && generation.load(boost::memory_order_acquire) == seen; i++){}
+		if (generation.load(boost::memory_order_acquire) == seen){
+			boost::mutex::scoped_lock lock(mutex);
+			while (generation == seen && !stop) job_cond.wait(lock);
+		}
+		if (stop) return;
+		seen = generation;
+		//	claim a participant, the workers beyond the ranges of the job go back to sleep
+		const int slot = slots.fetch_sub(1);
+		if (slot <= 0) continue;
+		run(slot);
+		if (pending.fetch_sub(1) == 1){
+			boost::mutex::scoped_lock lock(mutex);
+			done_cond.notify_one();
+		}
+	}
+}
+
+void ThreadPool::run(int id){
+	for (int k = 0; k < num_ranges; k++){
+		Range& range = ranges[(id + k) % num_ranges];
+		while (true){
+			const int lo = range.next.fetch_add(grain);
+			if (lo >= range.end) break;
+			(*job)(lo, min(lo + grain, range.end));
+		}
+	}
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const boost::function<void(int, int)>& fn){
+	if (begin >= end) return;
+	grain = max(grain, 1);
+	const int num_chunks = (end - begin + grain - 1) / grain;
+	if (num_workers == 0 || num_chunks == 1 || inParallel()){
+		fn(begin, end);
+		return;
+	}
+	//	split into grain-aligned ranges, one for each participant
+	num_ranges = min(size(), num_chunks);
+	const int chunks_per_range = num_chunks / num_ranges;
+	const int rest = num_chunks % num_ranges;
+	int lo = begin;
+	for (int i = 0; i < num_ranges; i++){
+		const int hi = min(end, lo + (chunks_per_range + (i < rest)) * grain);
+		ranges[i].next.store(lo, boost::memory_order_relaxed);
+		ranges[i].end = hi;
+		lo = hi;
+	}
+	job = &fn;
+	this->grain = grain;
+	//	the caller takes range 0, a worker is needed for each of the others
+	const int helpers = num_ranges - 1;
+	pending = helpers;
+	slots = helpers;
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		generation.fetch_add(1, boost::memory_order_release);
+		//	a small region only wakes the workers it can use
+		//	a woken worker may find the slots taken by the spinning ones, it sleeps again
+		if (helpers >= num_workers) job_cond.notify_all();
+		else for (int i = 0; i < helpers; i++) job_cond.notify_one();
+	}
+	current_pool.reset(this);
+	run(0);
+	current_pool.reset();
+	//	the caller usually finishes last, wait for the stolen chunks
+	for (int i = 0; i < SPIN_COUNT && pending > 0; i++){}
+	if (pending > 0){
+		boost::mutex::scoped_lock lock(mutex);
+		while (pending > 0) done_cond.wait(lock);
+	}
+	job = NULL;
+}
+
+void dragon_parallel_for(int begin, int end, int grain, const boost::function<void(int, int)>& fn){
+	if (begin >= end) return;
+	//	check it before Dragon::Get(), which creates a Dragon for a worker thread
+	ThreadPool* pool = NULL;
+	if (end - begin > grain && !ThreadPool::inParallel()) pool = Dragon::get_thread_pool();
+	if (pool) pool->parallelFor(begin, end, grain, fn);
+	else fn(begin, end);
+}
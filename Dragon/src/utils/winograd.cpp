@@ -0,0 +1,164 @@
+#include "utils/winograd.hpp"
+#include "utils/math.hpp"
+
+//	transform matrices, see also https://github.com/andravin/wincnn
+static const double BT_2[4 * 4] = {
+	1, 0, -1, 0,
+	0, 1, 1, 0,
+	0, -1, 1, 0,
+	0, 1, 0, -1 };
+static const double G_2[4 * 3] = {
+	1, 0, 0,
+	0.5, 0.5, 0.5,
+	0.5, -0.5, 0.5,
+	0, 0, 1 };
+static const double AT_2[2 * 4] = {
+	1, 1, 1, 0,
+	0, 1, -1, -1 };
+static const double BT_4[6 * 6] = {
+	4, 0, -5, 0, 1, 0,
+	0, -4, -4, 1, 1, 0,
+	0, 4, -4, -1, 1, 0,
+	0, -2, -1, 2, 1, 0,
+	0, 2, -1, -2, 1, 0,
+	0, 4, 0, -5, 0, 1 };
+static const double G_4[6 * 3] = {
+	1.0 / 4, 0, 0,
+	-1.0 / 6, -1.0 / 6, -1.0 / 6,
+	-1.0 / 6, 1.0 / 6, -1.0 / 6,
+	1.0 / 24, 1.0 / 12, 1.0 / 6,
+	1.0 / 24, -1.0 / 12, 1.0 / 6,
+	0, 0, 1 };
+static const double AT_4[4 * 6] = {
+	1, 1, 1, 1, 1, 0,
+	0, 1, -1, 2, -2, 0,
+	0, 1, 1, 4, 4, 0,
+	0, 1, -1, 8, -8, 1 };
+
+//	y[rows, rows] = mat[rows, cols] * x[cols, cols] * mat^T
+template<typename Dtype>
+static inline void sandwich(const double* mat, const int rows, const int cols, const Dtype* x, Dtype* y){
+	Dtype tmp[6 * 6];
+	//	tmp[rows, cols] = mat * x
+	for (int i = 0; i < rows; i++){
+		for (int j = 0; j < cols; j++){
+			Dtype sum = 0;
+			for (int k = 0; k < cols; k++) sum += Dtype(mat[i*cols + k])*x[k*cols + j];
+			tmp[i*cols + j] = sum;
+		}
+	}
+	//	y = tmp * mat^T
+	for (int i = 0; i < rows; i++){
+		for (int j = 0; j < rows; j++){
+			Dtype sum = 0;
+			for (int k = 0; k < cols; k++) sum += tmp[i*cols + k] * Dtype(mat[j*cols + k]);
+			y[i*rows + j] = sum;
+		}
+	}
+}
+
+template<typename Dtype>
+void winograd_transform_weights(const Dtype* weights, const int out_channels, const int in_channels,
+	const int m, const bool flip, Dtype* transformed){
+	CHECK(m == 2 || m == 4) << "only F(2x2,3x3) and F(4x4,3x3) are supported";
+	const double* G = m == 2 ? G_2 : G_4;
+	const int alpha = m + 2, tile = alpha*alpha;
+	const int rows = flip ? in_channels : out_channels;
+	const int cols = flip ? out_channels : in_channels;
+	Dtype g[9], u[6 * 6];
+	for (int o = 0; o < out_channels; o++){
+		for (int c = 0; c < in_channels; c++){
+			const Dtype* kernel = weights + (o*in_channels + c) * 9;
+			for (int i = 0; i < 9; i++) g[i] = flip ? kernel[8 - i] : kernel[i];
+			//	G*g*G^T, g is 3x3 while G is alphax3
+			Dtype tmp[6 * 3];
+			for (int i = 0; i < alpha; i++)
+				for (int j = 0; j < 3; j++)
+					tmp[i * 3 + j] = Dtype(G[i * 3])*g[j] + Dtype(G[i * 3 + 1])*g[3 + j] + Dtype(G[i * 3 + 2])*g[6 + j];
+			for (int i = 0; i < alpha; i++)
+				for (int j = 0; j < alpha; j++)
+					u[i*alpha + j] = tmp[i * 3] * Dtype(G[j * 3]) + tmp[i * 3 + 1] * Dtype(G[j * 3 + 1]) + tmp[i * 3 + 2] * Dtype(G[j * 3 + 2]);
+			const int row = flip ? c : o, col = flip ? o : c;
+			for (int xi = 0; xi < tile; xi++)
+				transformed[(xi*rows + row)*cols + col] = u[xi];
+		}
+	}
+}
+
+size_t winograd_workspace_count(const int num, const int channels, const int out_channels,
+	const int out_height, const int out_width, const int m){
+	const int tiles = ((out_height + m - 1) / m)*((out_width + m - 1) / m)*num;
+	return (size_t)(m + 2)*(m + 2)*tiles*(channels + out_channels);
+}
+
+template<typename Dtype>
+void winograd_conv_cpu(const Dtype* im, const int num, const int channels, const int height, const int width,
+	const int pad_h, const int pad_w, const Dtype* transformed, const int out_channels, const int m,
+	Dtype* out, Dtype* workspace){
+	CHECK(m == 2 || m == 4) << "only F(2x2,3x3) and F(4x4,3x3) are supported";
+	const double* BT = m == 2 ? BT_2 : BT_4;
+	const double* AT = m == 2 ? AT_2 : AT_4;
+	const int alpha = m + 2, tile = alpha*alpha;
+	const int out_height = height + 2 * pad_h - 2, out_width = width + 2 * pad_w - 2;
+	const int tiles_h = (out_height + m - 1) / m, tiles_w = (out_width + m - 1) / m;
+	const int image_tiles = tiles_h*tiles_w, tiles = image_tiles*num;
+	//	V[tile, channels, tiles], M[tile, out_channels, tiles]
+	Dtype* V = workspace;
+	Dtype* M = workspace + (size_t)tile*channels*tiles;
+	Dtype d[6 * 6], v[6 * 6];
+	//	input transform: B^T*d*B for each tile of each channel
+	for (int n = 0; n < num; n++){
+		for (int c = 0; c < channels; c++){
+			const Dtype* map = im + (n*channels + c)*height*width;
+			for (int th = 0; th < tiles_h; th++){
+				for (int tw = 0; tw < tiles_w; tw++){
+					const int h0 = th*m - pad_h, w0 = tw*m - pad_w;
+					for (int i = 0; i < alpha; i++){
+						const int h = h0 + i;
+						for (int j = 0; j < alpha; j++){
+							const int w = w0 + j;
+							d[i*alpha + j] = (h >= 0 && h < height && w >= 0 && w < width) ? map[h*width + w] : 0;
+						}
+					}
+					sandwich(BT, alpha, alpha, d, v);
+					const int t = n*image_tiles + th*tiles_w + tw;
+					for (int xi = 0; xi < tile; xi++) V[((size_t)xi*channels + c)*tiles + t] = v[xi];
+				}
+			}
+		}
+	}
+	//	M[xi] = U[xi] * V[xi], a batch of tile gemms over all tiles of all images
+	for (int xi = 0; xi < tile; xi++){
+		dragon_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_channels, tiles, channels, (Dtype)1.0,
+			transformed + (size_t)xi*out_channels*channels, V + (size_t)xi*channels*tiles,
+			(Dtype)0.0, M + (size_t)xi*out_channels*tiles);
+	}
+	//	output transform: A^T*M*A, clip the tiles at the right/bottom border
+	Dtype y[4 * 4];
+	for (int n = 0; n < num; n++){
+		for (int o = 0; o < out_channels; o++){
+			Dtype* map = out + (n*out_channels + o)*out_height*out_width;
+			for (int th = 0; th < tiles_h; th++){
+				for (int tw = 0; tw < tiles_w; tw++){
+					const int t = n*image_tiles + th*tiles_w + tw;
+					for (int xi = 0; xi < tile; xi++) d[xi] = M[((size_t)xi*out_channels + o)*tiles + t];
+					sandwich(AT, m, alpha, d, y);
+					for (int i = 0; i < m && th*m + i < out_height; i++)
+						for (int j = 0; j < m && tw*m + j < out_width; j++)
+							map[(th*m + i)*out_width + tw*m + j] = y[i*m + j];
+				}
+			}
+		}
+	}
+}
+
+template void winograd_transform_weights<float>(const float* weights, const int out_channels, const int in_channels,
+	const int m, const bool flip, float* transformed);
+template void winograd_transform_weights<double>(const double* weights, const int out_channels, const int in_channels,
+	const int m, const bool flip, double* transformed);
+template void winograd_conv_cpu<float>(const float* im, const int num, const int channels, const int height, const int width,
+	const int pad_h, const int pad_w, const float* transformed, const int out_channels, const int m,
+	float* out, float* workspace);
+template void winograd_conv_cpu<double>(const double* im, const int num, const int channels, const int height, const int width,
+	const int pad_h, const int pad_w, const double* transformed, const int out_channels, const int m,
+	double* out, double* workspace);
@@ -0,0 +1,26 @@
+#include "utils/workspace.hpp"
+
+static boost::thread_specific_ptr<Workspace> thread_workspace;
+
+Workspace& Workspace::Get(){
+	if (!thread_workspace.get()) thread_workspace.reset(new Workspace());
+	return *(thread_workspace.get());
+}
+
+void* Workspace::cpu(size_t size){
+	size = max(size, reserved);
+	if (!cpu_buffer || cpuSize() < size) cpu_buffer.reset(new SyncedMemory(size));
+	return cpu_buffer->mutable_cpu_data();
+}
+
+void* Workspace::gpu(size_t size){
+	size = max(size, reserved);
+	if (!gpu_buffer || gpuSize() < size) gpu_buffer.reset(new SyncedMemory(size));
+	return gpu_buffer->mutable_gpu_data();
+}
+
+void Workspace::release(){
+	cpu_buffer.reset();
+	gpu_buffer.reset();
+	reserved = 0;
+}